@@ -0,0 +1,406 @@
+#include "header.h"
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+/*
+Microbenchmarks for the sampling hot paths. Build and run with:
+
+    make bench && ./monitor_bench --root bench-fixture [--json] [--filter TEXT]
+
+`make bench` also generates bench-fixture/, a fixturegen tree that stays the
+same between runs and releases; without --root the live /proc and /sys are
+measured instead. Every benchmark reports:
+
+    ns/op           wall time of the timed loop divided by its iterations
+    allocs/op       malloc, calloc and realloc calls during the timed loop,
+                    operator new and stdio included
+    syscalls/op     system calls made by a separate, ptrace'd pass in a
+                    forked copy of this process (-1 when ptrace is denied)
+
+--json prints one JSON object per benchmark per line, for diffing runs.
+*/
+
+// glibc's own allocator entry points, which the wrappers below forward to
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* block, size_t size);
+
+// Interposed over libc for the whole process, so stdio buffers and FILE
+// objects are counted along with operator new, which allocates through malloc
+static std::atomic<uint64_t> g_allocations{0};
+
+extern "C" void* malloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* block, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(block, size);
+}
+
+// Previous ProcessMetrics::getProcessStats, kept as the baseline
+static ProcessStats legacyParseProcessStats(char* line) {
+    ProcessStats stats{};
+    char* token = strtok(line, " ");
+    int field = 1;
+
+    while (token && field <= 24) {
+        switch (field) {
+            case 14: stats.utime = atoll(token); break;
+            case 15: stats.stime = atoll(token); break;
+            case 16: stats.cutime = atoll(token); break;
+            case 17: stats.cstime = atoll(token); break;
+            case 22: stats.starttime = atoll(token); break;
+            case 23: stats.vsize = atoll(token); break;
+            case 24: stats.rss = atoll(token); break;
+        }
+        token = strtok(NULL, " ");
+        field++;
+    }
+    return stats;
+}
+
+static ProcessStats legacyGetProcessStats(pid_t pid) {
+    char path[256], resolved[PATH_MAX];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE* file = fopen(resolveKernelPath(path, resolved), "r");
+    if (!file) throw std::runtime_error("Could not open process stats");
+
+    ProcessStats stats{};
+    char line[1024];
+    if (fgets(line, sizeof(line), file)) {
+        stats = legacyParseProcessStats(line);
+    }
+    fclose(file);
+    return stats;
+}
+
+// Keeps the optimizer from discarding benchmark results
+static volatile long long g_sink;
+
+static const int CPU_KERNEL_RUNS = CPU_DELTA_AVX2 + 1;
+
+static bool g_json = false;
+static const char* g_filter = nullptr;
+
+// Runs body in a forked copy of this process under ptrace and counts the
+// syscall entries it makes; the copy inherits warm caches and open
+// descriptors, so it does what the timed loop did. -1 if ptrace is denied.
+template <typename F>
+static double countSyscalls(int iterations, F& body) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child < 0) return -1.0;
+    if (child == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0) _exit(2);
+        raise(SIGSTOP);
+        for (int i = 0; i < iterations; i++) body();
+        syscall(SYS_exit_group, 0);     // the one syscall counted after the loop
+    }
+
+    int status;
+    if (waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status)) {
+        if (!WIFEXITED(status) && !WIFSIGNALED(status)) waitpid(child, &status, 0);
+        return -1.0;
+    }
+    ptrace(PTRACE_SETOPTIONS, child, nullptr, (void*)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+    // Syscall stops alternate entry, exit; the initial SIGSTOP is swallowed
+    long long entries = 0;
+    bool in_syscall = false;
+    int pending_signal = 0;
+    while (ptrace(PTRACE_SYSCALL, child, nullptr, (void*)(long)pending_signal) == 0) {
+        if (waitpid(child, &status, 0) < 0 || WIFEXITED(status) || WIFSIGNALED(status)) break;
+        pending_signal = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            if (!in_syscall) entries++;
+            in_syscall = !in_syscall;
+        } else if (WSTOPSIG(status) != SIGSTOP) {
+            pending_signal = WSTOPSIG(status);
+        }
+    }
+    if (!WIFEXITED(status) && !WIFSIGNALED(status)) {
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+    }
+    return (double)(entries - 1) / iterations;
+}
+
+template <typename F>
+static void runBenchmark(const char* name, int iterations, F body) {
+    if (g_filter && !strstr(name, g_filter)) return;
+
+    // Warm up caches, the page cache and any reused buffers
+    for (int i = 0; i < std::max(iterations / 10, 1); i++) body();
+
+    uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) body();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    double allocs = (double)allocations / iterations;
+    double syscalls = countSyscalls(std::max(iterations / 1000, 1), body);
+
+    if (g_json) {
+        printf("{\"name\":\"%s\",\"iterations\":%d,\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f,"
+               "\"syscalls_per_op\":%.3f}\n", name, iterations, ns, allocs, syscalls);
+    } else {
+        printf("%-44s %12.1f ns/op %9.2f allocs/op %9.2f syscalls/op  (%d iterations)\n",
+               name, ns, allocs, syscalls, iterations);
+    }
+}
+
+static void section(const char* title) {
+    if (!g_json) printf("== %s ==\n", title);
+}
+
+static bool checkParser() {
+    // comm containing spaces and ')' used to shift every later field
+    const char* tricky = "4242 (evil) name (x)) S 1 4242 4242 0 -1 4194560 1000 0 5 0 "
+                         "1234 567 89 10 20 0 3 0 99999 123456789 2500 18446744073709551615 "
+                         "1 1 0 0 0 0 0 0 0 0 0 0 17 3 0 0 7 0 0 0 0 0 0 0 0 0";
+    ProcStat stat;
+    if (!parseProcStat(tricky, strlen(tricky), stat)) return false;
+    return stat.pid == 4242 && strcmp(stat.comm, "evil) name (x)") == 0 &&
+           stat.state == 'S' && stat.utime == 1234 && stat.stime == 567 &&
+           stat.starttime == 99999 && stat.rss == 2500 && stat.rsslim == -1 &&
+           stat.processor == 3 && stat.delayacct_blkio_ticks == 7;
+}
+
+// Reaps a watched child between two scans and checks that its exit record
+// still reaches the table as one last row. Needs taskstats, so it only runs
+// live and with CAP_NET_ADMIN; returns true when it cannot run.
+static bool checkExitAccounting() {
+    if (!kernelRoot().empty()) return true;
+    int go[2];
+    if (pipe(go) < 0) return false;
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child == 0) {
+        char byte;
+        ssize_t ignored = read(go[0], &byte, 1);
+        char path[] = "/tmp/monitor_bench_XXXXXX";
+        int fd = mkstemp(path);
+        static char block[64 * 1024];
+        for (int i = 0; fd >= 0 && i < 4; i++) ignored = write(fd, block, sizeof(block));
+        (void)ignored;
+        unlink(path);
+        _exit(0);
+    }
+    close(go[0]);
+
+    ProcessManager manager;
+    memset(manager.filter, 0, sizeof(manager.filter));
+    manager.show_delay_accounting = true;
+    std::vector<pid_t> watched{child};
+    manager.watch(watched);
+    ProcessSnapshot snapshot;
+    manager.update(snapshot, (size_t)1 << 30);
+    bool available = snapshot.taskstats_available;
+
+    ssize_t ignored = write(go[1], "x", 1);
+    (void)ignored;
+    close(go[1]);
+    waitpid(child, nullptr, 0);
+    if (!available) {
+        fprintf(stderr, "taskstats unavailable: exit accounting not checked\n");
+        return true;
+    }
+
+    manager.update(snapshot, (size_t)1 << 30);
+    for (const ProcessInfo& proc : snapshot.rows) {
+        if (proc.pid == child) {
+            return proc.state == 'X' && proc.delay.valid && proc.delay.write_rate > 0.0f;
+        }
+    }
+    return false;
+}
+
+// Times every kernel this CPU runs over synthetic counters and checks that
+// each matches the scalar reference bit for bit
+static bool benchCPUDeltas(size_t cores) {
+    std::vector<uint64_t> current[CPU_STATE_COUNT], previous[CPU_STATE_COUNT];
+    std::vector<float> shares[CPU_KERNEL_RUNS][CPU_STATE_COUNT], busy[CPU_KERNEL_RUNS];
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (int state = 0; state < CPU_STATE_COUNT; state++) {
+        for (size_t core = 0; core < cores; core++) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            uint64_t before = (seed >> 20) & 0xffffffffffull;
+            // Mostly small forward steps, some idle cores, a few counters going backwards
+            uint64_t step = (seed >> 8) % 40;
+            if (core % 97 == 5) step = 0;
+            previous[state].push_back(before);
+            current[state].push_back(core % 61 == 7 && state == CPU_STEAL ? before - 3 : before + step);
+        }
+    }
+
+    for (int kernel = CPU_DELTA_SCALAR; kernel <= bestCPUDeltaKernel(); kernel++) {
+        CPUDeltaColumns columns;
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            shares[kernel][state].assign(cores, -1.0f);
+            columns.current[state] = current[state].data();
+            columns.previous[state] = previous[state].data();
+            columns.shares[state] = shares[kernel][state].data();
+        }
+        busy[kernel].assign(cores, -1.0f);
+        columns.busy = busy[kernel].data();
+        columns.count = cores;
+        computeCPUDeltas(columns, (CPUDeltaKernel)kernel);
+
+        char name[64];
+        snprintf(name, sizeof(name), "computeCPUDeltas (%s)", describeCPUDeltaKernel((CPUDeltaKernel)kernel));
+        runBenchmark(name, 100000, [&] {
+            computeCPUDeltas(columns, (CPUDeltaKernel)kernel);
+            g_sink = (long long)busy[kernel][cores - 1];
+        });
+
+        if (memcmp(busy[kernel].data(), busy[0].data(), cores * sizeof(float)) != 0) {
+            return false;
+        }
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            if (memcmp(shares[kernel][state].data(), shares[0][state].data(), cores * sizeof(float)) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// This process on the live tree, the first process listed under a root
+static pid_t benchmarkPid() {
+    if (kernelRoot().empty()) return getpid();
+    KernelDirectory proc("/proc");
+    while (const char* name = proc.next()) {
+        if (name[0] >= '1' && name[0] <= '9') return atoi(name);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--root") == 0 && i + 1 < argc)
+            setKernelRoot(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0)
+            g_json = true;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            g_filter = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--root DIR] [--json] [--filter TEXT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!checkParser()) {
+        fprintf(stderr, "parseProcStat failed the self-check\n");
+        return 1;
+    }
+    if (!checkExitAccounting()) {
+        fprintf(stderr, "a reaped process's exit record did not reach the process table\n");
+        return 1;
+    }
+
+    pid_t pid = benchmarkPid();
+    char line[2048], path[32], resolved[PATH_MAX];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    {
+        FILE* file = fopen(resolveKernelPath(path, resolved), "r");
+        if (!file || !fgets(line, sizeof(line), file)) {
+            fprintf(stderr, "%s: cannot read\n", resolved);
+            return 1;
+        }
+        fclose(file);
+    }
+    size_t length = strlen(line);
+
+    section("/proc/[pid]/stat parsing (in memory)");
+    runBenchmark("legacy strtok parser", 1000000, [&] {
+        char copy[2048];
+        memcpy(copy, line, length + 1);
+        g_sink = legacyParseProcessStats(copy).rss;
+    });
+    runBenchmark("parseProcStat (all 52 fields)", 1000000, [&] {
+        char copy[2048];
+        memcpy(copy, line, length + 1);
+        ProcStat stat;
+        parseProcStat(copy, length, stat);
+        g_sink = stat.rss;
+    });
+
+    section("/proc/[pid]/stat read + parse");
+    runBenchmark("legacy getProcessStats (fopen/fgets)", 100000, [&] {
+        g_sink = legacyGetProcessStats(pid).rss;
+    });
+    runBenchmark("ProcessMetrics::readProcessStat", 100000, [&] {
+        ProcStat stat;
+        ProcessMetrics::readProcessStat(pid, stat);
+        g_sink = stat.rss;
+    });
+    runBenchmark("ProcessMetrics::getProcessStats", 100000, [&] {
+        g_sink = ProcessMetrics::getProcessStats(pid).rss;
+    });
+
+    section("collectors");
+    CPUData cpu;
+    runBenchmark("calculateCPUUsage", 100000, [&] {
+        g_sink = (long long)calculateCPUUsage(cpu);
+    });
+
+    section("per-core /proc/stat deltas (512 cores, in memory)");
+    if (!benchCPUDeltas(512)) {
+        fprintf(stderr, "computeCPUDeltas kernels disagree with the scalar reference\n");
+        return 1;
+    }
+
+    MemInfoReader meminfo_reader;
+    MemInfo meminfo;
+    runBenchmark("MemInfoReader::sample", 100000, [&] {
+        meminfo_reader.sample(meminfo);
+        g_sink = meminfo.mem_available;
+    });
+    RAMStatus ram;
+    runBenchmark("RAMStatus::update", 10000000, [&] {
+        ram.update(meminfo);
+        g_sink = ram.used;
+    });
+
+    NetworkSnapshot network;
+    runBenchmark("sampleNetwork (NetworkMonitor::update)", 20000, [&] {
+        sampleNetwork(network);
+        g_sink = network.interfaces.size();
+    });
+
+    ProcessManager manager;
+    memset(manager.filter, 0, sizeof(manager.filter));
+    ProcessSnapshot processes;
+    size_t total_memory = meminfo.mem_total * 1024;
+    runBenchmark("ProcessManager::update", 50, [&] {
+        manager.update(processes, total_memory);
+        g_sink = processes.rows.size();
+    });
+
+    section("UI helpers");
+    size_t row = 0;
+    if (!processes.rows.empty()) {
+        snprintf(manager.filter, sizeof(manager.filter), "%s", "post");
+        runBenchmark("ProcessManager::matchesFilter", 1000000, [&] {
+            g_sink = manager.matchesFilter(processes.rows[row]);
+            if (++row == processes.rows.size()) row = 0;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "header.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+Capture file layout, native byte order:
+
+    CaptureHeader                                   24 bytes
+    frames, one per task run:
+        CaptureFrame                                24 bytes
+        entries, entry_count of them:
+            CaptureEntry                            12 bytes
+            data                                    length bytes
+
+Paths are interned: the first use of a path in the file is preceded by a
+CAPTURE_PATH entry carrying its id and text, later entries only carry the
+id. A frame is written with a single write() when its task finishes, so a
+capture cut short by a crash ends at a frame boundary or is truncated
+inside the last frame, which replay ignores.
+*/
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    double created;             // CLOCK_REALTIME seconds
+};
+
+struct CaptureFrame {
+    uint32_t task;
+    uint32_t entry_count;
+    uint64_t payload_size;      // bytes of entries and data that follow
+    double time;                // monotonicSeconds() when the task started
+};
+
+struct CaptureEntry {
+    uint8_t kind;
+    uint8_t ok;
+    uint16_t reserved;
+    uint32_t path;
+    uint32_t length;
+};
+
+static const char CAPTURE_MAGIC[8] = {'S', 'M', 'C', 'A', 'P', 'T', 0, 1};
+static const uint32_t CAPTURE_VERSION = 1;
+
+static_assert(sizeof(CaptureHeader) == 24, "capture header layout");
+static_assert(sizeof(CaptureFrame) == 24, "capture frame layout");
+static_assert(sizeof(CaptureEntry) == 12, "capture entry layout");
+
+KernelCapture g_capture;
+thread_local bool KernelCapture::in_task = false;
+
+KernelCapture::~KernelCapture() {
+    close();
+}
+
+bool KernelCapture::openRecording(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(path.c_str());
+        return false;
+    }
+
+    CaptureHeader header = {};
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    header.version = CAPTURE_VERSION;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.created = now.tv_sec + now.tv_nsec / 1e9;
+    if (::write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        perror(path.c_str());
+        close();
+        return false;
+    }
+
+    frame.reserve(256 * 1024);
+    capture_mode = RECORD;
+    return true;
+}
+
+bool KernelCapture::openReplay(const std::string& path, double speed) {
+    close();
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (file < 0 || fstat(file, &info) < 0) {
+        perror(path.c_str());
+        if (file >= 0) ::close(file);
+        return false;
+    }
+    void* data = info.st_size > 0 ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    ::close(file);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: not a capture file\n", path.c_str());
+        return false;
+    }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    const CaptureHeader* header = (const CaptureHeader*)data;
+    if ((size_t)info.st_size < sizeof(CaptureHeader) ||
+        memcmp(header->magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+        header->version != CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a capture file\n", path.c_str());
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    mapping = (const char*)data;
+    mapping_size = info.st_size;
+    offset = sizeof(CaptureHeader);
+    replay_speed = std::max(speed, 0.01);
+    capture_mode = REPLAY;
+    return true;
+}
+
+void KernelCapture::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    if (mapping) munmap((void*)mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+    path_ids.clear();
+    paths.clear();
+    entries.clear();
+    capture_mode = LIVE;
+}
+
+bool KernelCapture::nextTask(SampleTask& task, double& time) {
+    if (capture_mode != REPLAY) return false;
+
+    CaptureFrame header;
+    if (offset + sizeof(header) > mapping_size) return false;
+    memcpy(&header, mapping + offset, sizeof(header));
+    if (header.task >= TASK_COUNT || header.payload_size > mapping_size - offset - sizeof(header)) {
+        return false;
+    }
+    const char* p = mapping + offset + sizeof(header);
+    const char* end = p + header.payload_size;
+    offset += sizeof(header) + header.payload_size;
+
+    entries.clear();
+    cursor = 0;
+    for (uint32_t i = 0; i < header.entry_count; i++) {
+        CaptureEntry entry;
+        if (end - p < (ptrdiff_t)sizeof(entry)) return false;
+        memcpy(&entry, p, sizeof(entry));
+        p += sizeof(entry);
+        if ((size_t)(end - p) < entry.length) return false;
+
+        if (entry.kind == CAPTURE_PATH) {
+            if (entry.path >= paths.size()) paths.resize(entry.path + 1);
+            paths[entry.path].assign(p, entry.length);
+        } else {
+            entries.push_back(Entry{(CaptureKind)entry.kind, entry.ok != 0, false,
+                                    entry.path, p, entry.length});
+        }
+        p += entry.length;
+    }
+
+    task = (SampleTask)header.task;
+    time = header.time;
+    frame_time = header.time;
+    return true;
+}
+
+void KernelCapture::beginTask(SampleTask task) {
+    if (capture_mode == LIVE) return;
+    if (capture_mode == RECORD) {
+        frame.resize(sizeof(CaptureFrame));
+        frame_entries = 0;
+        frame_time = monotonicSeconds();
+        CaptureFrame header = {};
+        header.task = task;
+        header.time = frame_time;
+        memcpy(frame.data(), &header, sizeof(header));
+    }
+    in_task = true;
+}
+
+void KernelCapture::endTask() {
+    if (!in_task) return;
+    in_task = false;
+    if (capture_mode != RECORD || fd < 0) return;
+
+    CaptureFrame header;
+    memcpy(&header, frame.data(), sizeof(header));
+    header.entry_count = frame_entries;
+    header.payload_size = frame.size() - sizeof(header);
+    memcpy(frame.data(), &header, sizeof(header));
+
+    const char* data = frame.data();
+    size_t remaining = frame.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("capture");
+            ::close(fd);
+            fd = -1;        // stop recording, keep sampling
+            return;
+        }
+        data += written;
+        remaining -= written;
+    }
+}
+
+uint32_t KernelCapture::pathId(const char* path) {
+    auto it = path_ids.find(path);
+    if (it != path_ids.end()) return it->second;
+    uint32_t id = path_ids.size();
+    path_ids.emplace(path, id);
+    appendEntry(CAPTURE_PATH, true, id, path, strlen(path));
+    return id;
+}
+
+void KernelCapture::appendEntry(CaptureKind kind, bool ok, uint32_t path, const void* data, size_t length) {
+    CaptureEntry entry = {};
+    entry.kind = kind;
+    entry.ok = ok;
+    entry.path = path;
+    entry.length = length;
+    size_t at = frame.size();
+    frame.resize(at + sizeof(entry) + length);
+    memcpy(frame.data() + at, &entry, sizeof(entry));
+    if (length > 0) memcpy(frame.data() + at + sizeof(entry), data, length);
+    frame_entries++;
+}
+
+void KernelCapture::store(CaptureKind kind, const char* path, const void* data, size_t length) {
+    if (!recording()) return;
+    appendEntry(kind, data != nullptr, pathId(path), data, data ? length : 0);
+}
+
+// Results are normally consumed in recorded order, so the match is almost
+// always at the cursor; the forward search only covers reads that moved
+bool KernelCapture::fetch(CaptureKind kind, const char* path, const char** data, size_t* length) {
+    if (!replaying()) return false;
+    for (size_t i = cursor; i < entries.size(); i++) {
+        Entry& entry = entries[i];
+        if (entry.used || entry.kind != kind) continue;
+        if (kind != CAPTURE_CLOCK && (entry.path >= paths.size() || paths[entry.path] != path)) continue;
+
+        entry.used = true;
+        while (cursor < entries.size() && entries[cursor].used) cursor++;
+        *data = entry.ok ? entry.data : nullptr;
+        *length = entry.length;
+        return true;
+    }
+    return false;
+}
+
+bool KernelCapture::replayValue(const char* name, std::string& value) {
+    const char* data;
+    size_t length;
+    if (!fetch(CAPTURE_VALUE, name, &data, &length)) return false;
+    value.assign(data ? data : "", data ? length : 0);
+    return true;
+}
+
+void KernelCapture::recordValue(const char* name, const std::string& value) {
+    store(CAPTURE_VALUE, name, value.data(), value.size());
+}
+
+// Recording reads the whole listing up front, so it lands in the frame
+// before anything the caller reads while walking it, as in replay
+KernelDirectory::KernelDirectory(const char* path) {
+    if (g_capture.replaying()) {
+        const char* data;
+        size_t length;
+        if (g_capture.fetch(CAPTURE_DIRECTORY, path, &data, &length) && data) {
+            replay_next = data;
+            replay_end = data + length;
+        }
+        return;
+    }
+
+    char resolved[PATH_MAX];
+    dir = opendir(resolveKernelPath(path, resolved));
+    if (!g_capture.recording()) return;
+    if (!dir) {
+        g_capture.store(CAPTURE_DIRECTORY, path, nullptr, 0);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        listing.append(entry->d_name, strlen(entry->d_name) + 1);
+    }
+    closedir(dir);
+    dir = nullptr;
+    g_capture.store(CAPTURE_DIRECTORY, path, listing.data(), listing.size());
+    replay_next = listing.data();
+    replay_end = listing.data() + listing.size();
+}
+
+KernelDirectory::~KernelDirectory() {
+    if (dir) closedir(dir);
+}
+
+const char* KernelDirectory::next() {
+    if (replay_next) {
+        if (replay_next >= replay_end) return nullptr;
+        const char* name = replay_next;
+        replay_next += strnlen(name, replay_end - name) + 1;
+        return name;
+    }
+    if (!dir) return nullptr;
+    struct dirent* entry = readdir(dir);
+    return entry ? entry->d_name : nullptr;
+}
+
+bool kernelPathExists(const char* path, int mode) {
+    if (g_capture.replaying()) {
+        const char* data;
+        size_t length;
+        return g_capture.fetch(CAPTURE_EXISTS, path, &data, &length) && data;
+    }
+    char resolved[PATH_MAX];
+    bool exists = access(resolveKernelPath(path, resolved), mode) == 0;
+    g_capture.store(CAPTURE_EXISTS, path, exists ? "" : nullptr, 0);
+    return exists;
+}
@@ -0,0 +1,246 @@
+#include "header.h"
+
+// Rates of the collectors without a slider, in Hz
+static const float FIXED_RATES[TASK_COUNT] = {
+    1.0f,   // TASK_SYSTEM_INFO
+    0.0f,   // TASK_CPU: slider
+    0.0f,   // TASK_FAN: slider
+    0.0f,   // TASK_THERMAL: slider
+    2.0f,   // TASK_MEMORY
+    0.2f,   // TASK_DISK
+    1.0f,   // TASK_PROCESSES
+    2.0f,   // TASK_NETWORK
+};
+
+Collector g_collector;
+
+const char* describeSampleTask(SampleTask task) {
+    switch (task) {
+        case TASK_SYSTEM_INFO: return "System info";
+        case TASK_CPU: return "CPU";
+        case TASK_FAN: return "Fan";
+        case TASK_THERMAL: return "Thermal";
+        case TASK_MEMORY: return "Memory";
+        case TASK_DISK: return "Disk";
+        case TASK_PROCESSES: return "Processes";
+        case TASK_NETWORK: return "Network";
+        default: return "?";
+    }
+}
+
+static float taskRate(SampleTask task) {
+    float rate = FIXED_RATES[task];
+    if (task == TASK_CPU || task == TASK_FAN || task == TASK_THERMAL) {
+        rate = systemSampleRate(task);
+    }
+    return std::max(rate, 0.01f);
+}
+
+void Collector::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) return;
+    running = true;
+    thread = std::thread(&Collector::run, this);
+}
+
+void Collector::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+// The flag is set under the mutex, so a change made while the scheduler is
+// between reading the rates and going to sleep still ends the wait
+void Collector::ratesChanged() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rates_pending = true;
+    }
+    wake.notify_all();
+}
+
+void Collector::runTask(SampleTask task) {
+    ScopedTimer timer((ProfileScope)task);
+    switch (task) {
+        case TASK_SYSTEM_INFO: updateSystemInfo(working.system.info); break;
+        case TASK_CPU: updateCPUData(working.system.cpu); break;
+        case TASK_FAN: updateFanData(working.system.fan); break;
+        case TASK_THERMAL: updateThermalData(working.system.thermal); break;
+        case TASK_MEMORY: sampleMemory(working.memory); break;
+        case TASK_DISK: working.memory.disk.update(); break;
+        case TASK_PROCESSES: sampleProcesses(working.processes, working.memory.meminfo); break;
+        case TASK_NETWORK: sampleNetwork(working.network); break;
+        default: break;
+    }
+}
+
+// Copy-assigning into a recycled slot reuses its vectors' capacity
+void Collector::publish() {
+    working.sequence++;
+    snapshots.back() = working;
+    snapshots.publish();
+    if (export_enabled.load(std::memory_order_relaxed)) {
+        export_snapshots.back() = working;
+        export_snapshots.publish();
+    }
+    notifyPublished();
+}
+
+// Wakes the UI's event loop; one pending event is enough however many
+// snapshots arrive before the UI gets to it
+void Collector::notifyPublished() {
+    uint32_t type = snapshot_event;
+    if (type == 0 || snapshot_event_pending.exchange(true)) return;
+    SDL_Event event = {};
+    event.type = type;
+    if (SDL_PushEvent(&event) <= 0) snapshot_event_pending = false;
+}
+
+void Collector::run() {
+    if (g_capture.mode() == KernelCapture::REPLAY) {
+        runReplay();
+        return;
+    }
+
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double> seconds;
+
+    struct Deadline {
+        clock::time_point due;
+        clock::time_point last_run;
+        SampleTask task;
+    };
+    // Earliest deadline first; ties go in SampleTask order, so memory runs
+    // before processes (which need MemTotal) when both are due
+    auto later = [](const Deadline& a, const Deadline& b) {
+        return a.due != b.due ? a.due > b.due : a.task > b.task;
+    };
+
+    clock::time_point start = clock::now();
+    std::vector<Deadline> heap;
+    TaskStats* stats = working.scheduler.tasks;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        heap.push_back({start, start, (SampleTask)i});
+        stats[i].rate = taskRate((SampleTask)i);
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+    bool claimed = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        rates_pending = false;
+        lock.unlock();
+
+        // Slider changes take effect from the task's last run, not its old deadline
+        bool rates_changed = false;
+        for (Deadline& deadline : heap) {
+            float rate = taskRate(deadline.task);
+            if (rate == stats[deadline.task].rate) continue;
+            stats[deadline.task].rate = rate;
+            clock::time_point due = deadline.last_run +
+                std::chrono::duration_cast<clock::duration>(seconds(1.0 / rate));
+            deadline.due = std::min(deadline.due, due);
+            rates_changed = true;
+        }
+        if (rates_changed) std::make_heap(heap.begin(), heap.end(), later);
+
+        clock::time_point now = clock::now();
+        bool ran = false;
+        while (heap.front().due <= now) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Deadline& deadline = heap.back();
+            TaskStats& task = stats[deadline.task];
+            clock::duration period = std::chrono::duration_cast<clock::duration>(seconds(1.0 / task.rate));
+
+            clock::time_point began = clock::now();
+            double lateness = seconds(began - deadline.due).count();
+            task.worst_lateness = std::max(task.worst_lateness, (float)lateness);
+            if (began - deadline.due >= period) {
+                task.missed += (began - deadline.due) / period;
+            }
+
+            g_capture.beginTask(deadline.task);
+            runTask(deadline.task);
+            g_capture.endTask();
+            clock::time_point finished = clock::now();
+            task.runs++;
+            task.last_duration = (float)seconds(finished - began).count();
+
+            // Stay on the original grid, but never queue up a burst of catch-up runs
+            deadline.last_run = began;
+            deadline.due += period;
+            if (deadline.due <= finished) deadline.due = finished + period;
+            std::push_heap(heap.begin(), heap.end(), later);
+            ran = true;
+        }
+
+        if (ran) publish();
+        // Every task was due at start, so the first batch sampled them all
+        // and asked for every metric that still has a source
+        if (ran && !claimed) {
+            claimed = true;
+            g_history.releaseUnclaimed();
+        }
+
+        clock::time_point next = heap.front().due;
+        lock.lock();
+        wake.wait_until(lock, next, [this] { return !running || rates_pending; });
+    }
+}
+
+// Runs the recorded tasks in their recorded order, spaced by their recorded
+// start times divided by the replay speed. Tasks that are already due are
+// published together, so a high speed does not publish per task.
+void Collector::runReplay() {
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double> seconds;
+
+    TaskStats* stats = working.scheduler.tasks;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        stats[i].rate = taskRate((SampleTask)i);
+    }
+
+    clock::time_point start = clock::now();
+    double first = -1.0;
+    bool unpublished = false;
+    SampleTask task;
+    double time;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        lock.unlock();
+        if (!g_capture.nextTask(task, time)) break;
+        if (first < 0.0) first = time;
+
+        clock::time_point due = start +
+            std::chrono::duration_cast<clock::duration>(seconds((time - first) / g_capture.speed()));
+        if (due > clock::now()) {
+            if (unpublished) publish();
+            unpublished = false;
+            lock.lock();
+            wake.wait_until(lock, due, [this] { return !running; });
+            if (!running) break;
+            lock.unlock();
+        }
+
+        clock::time_point began = clock::now();
+        g_capture.beginTask(task);
+        runTask(task);
+        g_capture.endTask();
+        stats[task].runs++;
+        stats[task].last_duration = (float)seconds(clock::now() - began).count();
+        unpublished = true;
+        lock.lock();
+    }
+    if (!lock.owns_lock()) lock.lock();
+
+    if (running) {
+        if (unpublished) publish();
+        fprintf(stderr, "Replay: end of capture\n");
+        wake.wait(lock, [this] { return !running; });
+    }
+}
@@ -0,0 +1,155 @@
+#include "header.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+Per-core /proc/stat deltas and shares. A row's work is ten 64-bit
+subtractions, a sum, and eleven multiplies by 100 / total, identical across
+rows, so the SIMD kernels take 2 (SSE2) or 4 (AVX2) rows per step straight
+from the column arrays and leave the tail to the scalar kernel.
+
+Neither instruction set converts unsigned 64-bit lanes to double, so deltas
+are ORed into the mantissa of 2^52 and 2^52 is subtracted again, which is
+exact below 2^52. All kernels then do the same double operations in the
+same order, so their results are bit-identical to the scalar reference.
+*/
+
+static void deltaScalar(const CPUDeltaColumns& columns, size_t row) {
+    for (; row < columns.count; row++) {
+        uint64_t delta[CPU_STATE_COUNT];
+        uint64_t total = 0;
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            uint64_t now = columns.current[state][row], before = columns.previous[state][row];
+            delta[state] = now > before ? now - before : 0;
+            if (state != CPU_GUEST && state != CPU_GUEST_NICE) total += delta[state];
+        }
+        double scale = total ? 100.0 / (double)total : 0.0;
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            columns.shares[state][row] = (float)((double)delta[state] * scale);
+        }
+        columns.busy[row] = (float)((double)(total - delta[CPU_IDLE] - delta[CPU_IOWAIT]) * scale);
+    }
+}
+
+#if defined(__x86_64__)
+
+static const long long TWO_POW_52_BITS = 0x4330000000000000LL;
+static const double TWO_POW_52 = 4503599627370496.0;
+
+// SSE2 is part of x86-64, so this one needs no target attribute
+static inline __m128d toDouble(__m128i value) {
+    __m128i biased = _mm_or_si128(value, _mm_set1_epi64x(TWO_POW_52_BITS));
+    return _mm_sub_pd(_mm_castsi128_pd(biased), _mm_set1_pd(TWO_POW_52));
+}
+
+// A negative difference has its lane's top bit set; SSE2 has no 64-bit
+// compare or arithmetic shift, so spread the high dword's sign instead
+static inline __m128i clampNegative(__m128i difference) {
+    __m128i sign = _mm_shuffle_epi32(_mm_srai_epi32(difference, 31), _MM_SHUFFLE(3, 3, 1, 1));
+    return _mm_andnot_si128(sign, difference);
+}
+
+static inline void storeShares(float* target, __m128d values) {
+    _mm_storel_epi64((__m128i*)target, _mm_castps_si128(_mm_cvtpd_ps(values)));
+}
+
+static size_t deltaSSE2(const CPUDeltaColumns& columns) {
+    size_t row = 0;
+    for (; row + 2 <= columns.count; row += 2) {
+        __m128i delta[CPU_STATE_COUNT];
+        __m128i total = _mm_setzero_si128();
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            __m128i now = _mm_loadu_si128((const __m128i*)(columns.current[state] + row));
+            __m128i before = _mm_loadu_si128((const __m128i*)(columns.previous[state] + row));
+            delta[state] = clampNegative(_mm_sub_epi64(now, before));
+            if (state != CPU_GUEST && state != CPU_GUEST_NICE) total = _mm_add_epi64(total, delta[state]);
+        }
+
+        __m128d total_pd = toDouble(total);
+        __m128d scale = _mm_and_pd(_mm_div_pd(_mm_set1_pd(100.0), total_pd),
+                                   _mm_cmpneq_pd(total_pd, _mm_setzero_pd()));
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            storeShares(columns.shares[state] + row, _mm_mul_pd(toDouble(delta[state]), scale));
+        }
+        __m128i busy = _mm_sub_epi64(_mm_sub_epi64(total, delta[CPU_IDLE]), delta[CPU_IOWAIT]);
+        storeShares(columns.busy + row, _mm_mul_pd(toDouble(busy), scale));
+    }
+    return row;
+}
+
+__attribute__((target("avx2")))
+static inline __m256d toDouble(__m256i value) {
+    __m256i biased = _mm256_or_si256(value, _mm256_set1_epi64x(TWO_POW_52_BITS));
+    return _mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(TWO_POW_52));
+}
+
+__attribute__((target("avx2")))
+static size_t deltaAVX2(const CPUDeltaColumns& columns) {
+    size_t row = 0;
+    for (; row + 4 <= columns.count; row += 4) {
+        __m256i delta[CPU_STATE_COUNT];
+        __m256i total = _mm256_setzero_si256();
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            __m256i now = _mm256_loadu_si256((const __m256i*)(columns.current[state] + row));
+            __m256i before = _mm256_loadu_si256((const __m256i*)(columns.previous[state] + row));
+            __m256i difference = _mm256_sub_epi64(now, before);
+            __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), difference);
+            delta[state] = _mm256_andnot_si256(negative, difference);
+            if (state != CPU_GUEST && state != CPU_GUEST_NICE) total = _mm256_add_epi64(total, delta[state]);
+        }
+
+        __m256d total_pd = toDouble(total);
+        __m256d scale = _mm256_and_pd(_mm256_div_pd(_mm256_set1_pd(100.0), total_pd),
+                                      _mm256_cmp_pd(total_pd, _mm256_setzero_pd(), _CMP_NEQ_OQ));
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            _mm_storeu_ps(columns.shares[state] + row, _mm256_cvtpd_ps(_mm256_mul_pd(toDouble(delta[state]), scale)));
+        }
+        __m256i busy = _mm256_sub_epi64(_mm256_sub_epi64(total, delta[CPU_IDLE]), delta[CPU_IOWAIT]);
+        _mm_storeu_ps(columns.busy + row, _mm256_cvtpd_ps(_mm256_mul_pd(toDouble(busy), scale)));
+    }
+    return row;
+}
+
+// AVX2 needs the CPU flag and an OS that saves the ymm registers (XCR0)
+static CPUDeltaKernel detectCPUDeltaKernel() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return CPU_DELTA_SSE2;
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return CPU_DELTA_SSE2;
+    unsigned int xcr0, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+    if ((xcr0 & 6) != 6) return CPU_DELTA_SSE2;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) return CPU_DELTA_SSE2;
+    return CPU_DELTA_AVX2;
+}
+
+#else
+
+static CPUDeltaKernel detectCPUDeltaKernel() {
+    return CPU_DELTA_SCALAR;
+}
+
+#endif
+
+CPUDeltaKernel bestCPUDeltaKernel() {
+    static const CPUDeltaKernel best = detectCPUDeltaKernel();
+    return best;
+}
+
+const char* describeCPUDeltaKernel(CPUDeltaKernel kernel) {
+    switch (kernel) {
+        case CPU_DELTA_SCALAR: return "scalar";
+        case CPU_DELTA_SSE2: return "sse2";
+        case CPU_DELTA_AVX2: return "avx2";
+        default: return "?";
+    }
+}
+
+void computeCPUDeltas(const CPUDeltaColumns& columns, CPUDeltaKernel kernel) {
+    size_t done = 0;
+#if defined(__x86_64__)
+    if (kernel == CPU_DELTA_AVX2) done = deltaAVX2(columns);
+    else if (kernel == CPU_DELTA_SSE2) done = deltaSSE2(columns);
+#endif
+    deltaScalar(columns, done);
+}
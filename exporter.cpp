@@ -0,0 +1,315 @@
+#include "header.h"
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+A deliberately small HTTP/1.0-style server: one connection at a time, one
+request per connection, "Connection: close". Anything but GET /metrics (or
+GET /) is answered 404. The OpenMetrics body ends with "# EOF" as the format
+requires, and counters carry the _total suffix on their samples.
+*/
+
+MetricsExporter g_exporter;
+
+static const char* OPENMETRICS_TYPE = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+// How long a client gets to send its request before it is dropped
+static const int REQUEST_TIMEOUT_MS = 2000;
+
+// Label values escape backslash, double quote and newline
+static void appendLabelValue(TextBuffer& out, const char* text) {
+    out.append("\"", 1);
+    for (const char* p = text; *p; p++) {
+        if (*p == '\\') out.append("\\\\", 2);
+        else if (*p == '"') out.append("\\\"", 2);
+        else if (*p == '\n') out.append("\\n", 2);
+        else out.append(p, 1);
+    }
+    out.append("\"", 1);
+}
+
+static void appendFamily(TextBuffer& out, const char* name, const char* type, const char* unit, const char* help) {
+    out.appendf("# TYPE %s %s\n", name, type);
+    if (unit) out.appendf("# UNIT %s %s\n", name, unit);
+    out.appendf("# HELP %s %s\n", name, help);
+}
+
+static void appendGauge(TextBuffer& out, const char* name, const char* unit, const char* help, double value) {
+    appendFamily(out, name, "gauge", unit, help);
+    out.appendf("%s %.15g\n", name, value);
+}
+
+MetricsExporter::~MetricsExporter() {
+    close();
+}
+
+bool MetricsExporter::open(const std::string& address, int top_processes) {
+    if (running) return true;
+    top_count = std::max(top_processes, 0);
+
+    if (address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "metrics: bad unix socket path '%s'\n", path.c_str());
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(path.c_str());       // a stale socket from an earlier run
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror(path.c_str());
+            close();
+            return false;
+        }
+        unix_path = path;
+    } else {
+        // "PORT" or "HOST:PORT"; a bare port stays on loopback
+        std::string host = "127.0.0.1";
+        std::string port = address;
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(port.c_str()));
+        if (addr.sin_port == 0 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            fprintf(stderr, "metrics: bad address '%s' (PORT, HOST:PORT or unix:PATH)\n", address.c_str());
+            return false;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (listen_fd >= 0) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror(address.c_str());
+            close();
+            return false;
+        }
+    }
+
+    if (listen(listen_fd, 16) < 0) {
+        perror("metrics: listen");
+        close();
+        return false;
+    }
+
+    listen_address = address;
+    request.resize(4096);
+    top.reserve(1024);
+    g_collector.enableExport();
+    running = true;
+    thread = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::close() {
+    if (running.exchange(false)) thread.join();
+    if (listen_fd >= 0) ::close(listen_fd);
+    listen_fd = -1;
+    if (!unix_path.empty()) unlink(unix_path.c_str());
+    unix_path.clear();
+}
+
+// Wakes up periodically so close() never waits on a blocked accept()
+void MetricsExporter::run() {
+    while (running) {
+        struct pollfd pending = {listen_fd, POLLIN, 0};
+        if (poll(&pending, 1, 250) <= 0) continue;
+
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        struct timeval timeout = {REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve(client);
+        ::close(client);
+    }
+}
+
+void MetricsExporter::serve(int client) {
+    // Read up to the end of the headers; a request body is never expected
+    size_t length = 0;
+    while (length + 1 < request.size()) {
+        ssize_t got = recv(client, request.data() + length, request.size() - 1 - length, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        length += got;
+        request[length] = '\0';
+        if (strstr(request.data(), "\r\n\r\n") || strstr(request.data(), "\n\n")) break;
+    }
+    if (length == 0) return;
+    request[length] = '\0';
+
+    const char* status = "200 OK";
+    const char* type = OPENMETRICS_TYPE;
+    bool is_get = strncmp(request.data(), "GET ", 4) == 0;
+    bool is_head = strncmp(request.data(), "HEAD ", 5) == 0;
+    const char* path = request.data() + (is_head ? 5 : 4);
+    size_t path_length = strcspn(path, " ?\r\n");
+
+    body.clear();
+    if (!is_get && !is_head) {
+        status = "405 Method Not Allowed";
+        type = "text/plain; charset=utf-8";
+        body.append("only GET is supported\n");
+    } else if ((path_length == 8 && strncmp(path, "/metrics", 8) == 0) ||
+               (path_length == 1 && path[0] == '/')) {
+        // The collector publishes at least once a second; before the first
+        // publish this renders the zeroed slot, which is still valid output
+        g_collector.acquireExport();
+        render(g_collector.currentExport());
+    } else {
+        status = "404 Not Found";
+        type = "text/plain; charset=utf-8";
+        body.append("try /metrics\n");
+    }
+
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                                 "Connection: close\r\n\r\n", status, type, body.size());
+
+    struct iovec parts[2] = {
+        {header, (size_t)header_length},
+        {(void*)body.data(), is_head ? 0 : body.size()},
+    };
+    int part = 0;
+    while (part < 2) {
+        // MSG_NOSIGNAL: a scraper hanging up early must not SIGPIPE the monitor
+        struct msghdr message = {};
+        message.msg_iov = parts + part;
+        message.msg_iovlen = 2 - part;
+        ssize_t sent = sendmsg(client, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        while (part < 2 && (size_t)sent >= parts[part].iov_len) {
+            sent -= parts[part].iov_len;
+            part++;
+        }
+        if (part < 2) {
+            parts[part].iov_base = (char*)parts[part].iov_base + sent;
+            parts[part].iov_len -= sent;
+        }
+    }
+}
+
+void MetricsExporter::render(const MonitorSnapshot& snapshot) {
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    const SystemSnapshot& system = snapshot.system;
+    const MemorySnapshot& memory = snapshot.memory;
+    TextBuffer& out = body;
+    scrapes++;
+
+    appendGauge(out, "system_monitor_cpu_usage_percent", "percent", "Total CPU utilization.",
+                system.cpu.current_usage);
+    appendFamily(out, "system_monitor_cpu_state_percent", "gauge", "percent",
+                 "Share of CPU time by state over the last interval; guest is included in user.");
+    for (int state = 0; state < CPU_STATE_COUNT; state++) {
+        out.appendf("system_monitor_cpu_state_percent{state=\"%s\"} %.15g\n",
+                    describeCPUState((CPUState)state), system.cpu.states[state]);
+    }
+    appendGauge(out, "system_monitor_temperature_celsius", "celsius", "CPU temperature.",
+                system.thermal.current_temp);
+    appendGauge(out, "system_monitor_fan_speed_rpm", "rpm", "Fan speed.", system.fan.speed);
+
+    appendGauge(out, "system_monitor_memory_used_bytes", "bytes", "RAM in use.", memory.ram.used);
+    appendGauge(out, "system_monitor_memory_total_bytes", "bytes", "Installed RAM.", memory.ram.total);
+    appendGauge(out, "system_monitor_swap_used_bytes", "bytes", "Swap in use.", memory.swap.used);
+    appendGauge(out, "system_monitor_swap_total_bytes", "bytes", "Swap configured.", memory.swap.total);
+    appendGauge(out, "system_monitor_disk_used_bytes", "bytes", "Root filesystem space in use.", memory.disk.used);
+    appendGauge(out, "system_monitor_disk_total_bytes", "bytes", "Root filesystem size.", memory.disk.total);
+
+    const SystemProcessStats& stats = snapshot.processes.stats;
+    appendFamily(out, "system_monitor_processes", "gauge", nullptr, "Tasks by scheduler state.");
+    out.appendf("system_monitor_processes{state=\"running\"} %d\n", stats.running);
+    out.appendf("system_monitor_processes{state=\"sleeping\"} %d\n", stats.sleeping);
+    out.appendf("system_monitor_processes{state=\"disk_sleep\"} %d\n", stats.disk_sleep);
+    out.appendf("system_monitor_processes{state=\"zombie\"} %d\n", stats.zombie);
+    out.appendf("system_monitor_processes{state=\"stopped\"} %d\n", stats.stopped);
+    out.appendf("system_monitor_processes{state=\"idle\"} %d\n", stats.idle);
+
+    // Per-interface kernel counters, one family per direction and kind
+    struct CounterColumn {
+        const char* name;
+        const char* unit;
+        const char* help;
+        uint64_t (*value)(const NetworkInterface&);
+    };
+    static const CounterColumn NETWORK_COUNTERS[] = {
+        {"system_monitor_network_receive_bytes", "bytes", "Bytes received.",
+         [](const NetworkInterface& i) { return i.rx.bytes; }},
+        {"system_monitor_network_transmit_bytes", "bytes", "Bytes transmitted.",
+         [](const NetworkInterface& i) { return i.tx.bytes; }},
+        {"system_monitor_network_receive_packets", nullptr, "Packets received.",
+         [](const NetworkInterface& i) { return i.rx.packets; }},
+        {"system_monitor_network_transmit_packets", nullptr, "Packets transmitted.",
+         [](const NetworkInterface& i) { return i.tx.packets; }},
+        {"system_monitor_network_receive_errors", nullptr, "Receive errors.",
+         [](const NetworkInterface& i) { return i.rx.errs; }},
+        {"system_monitor_network_transmit_errors", nullptr, "Transmit errors.",
+         [](const NetworkInterface& i) { return i.tx.errs; }},
+        {"system_monitor_network_receive_drops", nullptr, "Received packets dropped.",
+         [](const NetworkInterface& i) { return i.rx.drop; }},
+        {"system_monitor_network_transmit_drops", nullptr, "Transmitted packets dropped.",
+         [](const NetworkInterface& i) { return i.tx.drop; }},
+    };
+    for (const CounterColumn& column : NETWORK_COUNTERS) {
+        appendFamily(out, column.name, "counter", column.unit, column.help);
+        for (const NetworkInterface& iface : snapshot.network.interfaces) {
+            out.appendf("%s_total{interface=", column.name);
+            appendLabelValue(out, iface.name.c_str());
+            out.appendf("} %" PRIu64 "\n", column.value(iface));
+        }
+    }
+
+    // Top processes by CPU; pointers into the snapshot, so nothing is copied
+    top.clear();
+    for (const ProcessInfo& proc : snapshot.processes.rows) {
+        top.push_back(&proc);
+    }
+    size_t count = std::min(top.size(), (size_t)top_count);
+    std::partial_sort(top.begin(), top.begin() + count, top.end(),
+                      [](const ProcessInfo* a, const ProcessInfo* b) {
+                          return a->metrics.cpu_usage > b->metrics.cpu_usage;
+                      });
+
+    appendFamily(out, "system_monitor_process_cpu_percent", "gauge", "percent",
+                 "CPU use of the busiest processes, in % of one core.");
+    for (size_t i = 0; i < count; i++) {
+        out.appendf("system_monitor_process_cpu_percent{pid=\"%d\",name=", top[i]->pid);
+        appendLabelValue(out, top[i]->name);
+        out.appendf("} %.2f\n", top[i]->metrics.cpu_usage);
+    }
+    appendFamily(out, "system_monitor_process_resident_bytes", "gauge", "bytes",
+                 "Resident memory of the busiest processes.");
+    for (size_t i = 0; i < count; i++) {
+        out.appendf("system_monitor_process_resident_bytes{pid=\"%d\",name=", top[i]->pid);
+        appendLabelValue(out, top[i]->name);
+        out.appendf("} %lld\n", top[i]->last_stats.rss * page_size);
+    }
+
+    // The monitor's own scheduling, so a stalled collector is visible
+    appendFamily(out, "system_monitor_collector_runs", "counter", nullptr, "Collector task runs.");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        out.appendf("system_monitor_collector_runs_total{task=\"%s\"} %" PRIu64 "\n",
+                    describeSampleTask((SampleTask)i), snapshot.scheduler.tasks[i].runs);
+    }
+    appendFamily(out, "system_monitor_collector_missed", "counter", nullptr,
+                 "Collector task periods skipped because a run came late.");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        out.appendf("system_monitor_collector_missed_total{task=\"%s\"} %" PRIu64 "\n",
+                    describeSampleTask((SampleTask)i), snapshot.scheduler.tasks[i].missed);
+    }
+    appendFamily(out, "system_monitor_snapshots", "counter", nullptr, "Snapshots published by the collector.");
+    out.appendf("system_monitor_snapshots_total %" PRIu64 "\n", snapshot.sequence);
+    appendFamily(out, "system_monitor_scrapes", "counter", nullptr, "Scrapes served.");
+    out.appendf("system_monitor_scrapes_total %" PRIu64 "\n", scrapes);
+    out.append("# EOF\n");
+}
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string>
+#include <algorithm>
+#include <sys/stat.h>
+
+/*
+Writes a synthetic /proc and /sys tree for running the monitor at scale:
+
+    make fixturegen
+    ./fixturegen --root /tmp/fixture --processes 100000 --cores 512
+    ./monitor --root /tmp/fixture
+
+Only the files the collectors read are generated. Every cumulative counter
+is a base value plus a per-item rate times --time, so regenerating the same
+tree with a later --time (same seed) makes the monitor see the counters
+advance, as it would on a live host:
+
+    ./fixturegen --root /tmp/fixture --time 0
+    ./monitor --root /tmp/fixture --headless &
+    ./fixturegen --root /tmp/fixture --time 1
+
+Regenerate into a fresh directory when lowering --processes; pids beyond
+the new count are not removed.
+*/
+
+struct FixtureOptions {
+    std::string root;
+    int processes = 1000;
+    int interfaces = 4;
+    int sensors = 2;
+    int cores = 8;
+    double time = 0.0;
+    uint64_t seed = 1;
+};
+
+static const long PF_KTHREAD = 0x00200000;
+static const int TICKS = 100;
+
+// Deterministic per-item values: the same seed and index always give the same numbers
+static uint64_t mix(uint64_t seed, uint64_t index, uint64_t salt) {
+    uint64_t x = seed * 0x9E3779B97F4A7C15ull + index * 0xBF58476D1CE4E5B9ull + salt * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    x *= 0xD6E8FEB86659FD93ull;
+    x ^= x >> 32;
+    return x;
+}
+
+static uint64_t pick(uint64_t seed, uint64_t index, uint64_t salt, uint64_t limit) {
+    return limit ? mix(seed, index, salt) % limit : 0;
+}
+
+static bool makeDirectories(const std::string& path) {
+    for (size_t slash = 1; slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) return false;
+    }
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+static FILE* create(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) perror(path.c_str());
+    return file;
+}
+
+static bool writeText(const std::string& path, const char* text) {
+    FILE* file = create(path);
+    if (!file) return false;
+    fputs(text, file);
+    fclose(file);
+    return true;
+}
+
+static bool writeProcStat(const FixtureOptions& options) {
+    FILE* file = create(options.root + "/proc/stat");
+    if (!file) return false;
+
+    // Each core: a busy fraction in [5%, 95%), split across the states
+    std::string lines;
+    uint64_t total[10] = {};
+    char line[256];
+    for (int core = 0; core < options.cores; core++) {
+        double busy = 0.05 + pick(options.seed, core, 1, 90) / 100.0;
+        double ticks = (1000000.0 + options.time) * TICKS;
+        uint64_t fields[10] = {
+            (uint64_t)(ticks * busy * 0.70),        // user
+            (uint64_t)(ticks * busy * 0.02),        // nice
+            (uint64_t)(ticks * busy * 0.20),        // system
+            (uint64_t)(ticks * (1.0 - busy) * 0.97),// idle
+            (uint64_t)(ticks * (1.0 - busy) * 0.03),// iowait
+            (uint64_t)(ticks * busy * 0.03),        // irq
+            (uint64_t)(ticks * busy * 0.04),        // softirq
+            (uint64_t)(ticks * busy * 0.01),        // steal
+            0, 0,                                   // guest, guest_nice
+        };
+        snprintf(line, sizeof(line), "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n", core,
+                 (unsigned long long)fields[0], (unsigned long long)fields[1], (unsigned long long)fields[2],
+                 (unsigned long long)fields[3], (unsigned long long)fields[4], (unsigned long long)fields[5],
+                 (unsigned long long)fields[6], (unsigned long long)fields[7], (unsigned long long)fields[8],
+                 (unsigned long long)fields[9]);
+        lines += line;
+        for (int i = 0; i < 10; i++) total[i] += fields[i];
+    }
+
+    fprintf(file, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
+            (unsigned long long)total[0], (unsigned long long)total[1], (unsigned long long)total[2],
+            (unsigned long long)total[3], (unsigned long long)total[4], (unsigned long long)total[5],
+            (unsigned long long)total[6], (unsigned long long)total[7], (unsigned long long)total[8],
+            (unsigned long long)total[9]);
+    fputs(lines.c_str(), file);
+    fprintf(file, "intr 0\nctxt %llu\nbtime 1700000000\nprocesses %d\nprocs_running %d\nprocs_blocked 0\n",
+            (unsigned long long)((1000000.0 + options.time) * 1000 * options.cores),
+            options.processes, std::max(1, options.processes / 100));
+    fclose(file);
+    return true;
+}
+
+static bool writeCpuinfo(const FixtureOptions& options) {
+    FILE* file = create(options.root + "/proc/cpuinfo");
+    if (!file) return false;
+    for (int core = 0; core < options.cores; core++) {
+        fprintf(file, "processor\t: %d\nvendor_id\t: GenuineIntel\n"
+                      "model name\t: Fixture CPU @ 3.00GHz (%d cores)\ncpu MHz\t\t: 3000.000\n\n",
+                core, options.cores);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool writeMeminfo(const FixtureOptions& options, uint64_t rss_kb) {
+    FILE* file = create(options.root + "/proc/meminfo");
+    if (!file) return false;
+    uint64_t total = std::max<uint64_t>(16ull << 20, rss_kb * 2);
+    uint64_t available = total - rss_kb - total / 20;
+    uint64_t swap_total = total / 4;
+    fprintf(file,
+            "MemTotal:       %llu kB\nMemFree:        %llu kB\nMemAvailable:   %llu kB\n"
+            "Buffers:        %llu kB\nCached:         %llu kB\nSwapCached:     0 kB\n"
+            "Active:         %llu kB\nInactive:       %llu kB\n"
+            "SwapTotal:      %llu kB\nSwapFree:       %llu kB\nDirty:          0 kB\n"
+            "Shmem:          0 kB\nSlab:           %llu kB\nHugePages_Total:       0\n"
+            "Hugepagesize:       2048 kB\n",
+            (unsigned long long)total, (unsigned long long)(available / 2), (unsigned long long)available,
+            (unsigned long long)(total / 100), (unsigned long long)(available / 2),
+            (unsigned long long)rss_kb, (unsigned long long)(total / 10),
+            (unsigned long long)swap_total, (unsigned long long)(swap_total - swap_total / 10),
+            (unsigned long long)(total / 50));
+    fclose(file);
+    return true;
+}
+
+// One /proc/[pid]/stat per process; about one in ten is a kernel thread
+// (ppid 2, PF_KTHREAD, no memory). Returns the summed RSS in kB.
+static bool writeProcesses(const FixtureOptions& options, uint64_t& rss_kb) {
+    static const char STATES[] = "SSSSSSSSRRDIZT";
+    static const char* NAMES[] = {"bash", "sshd", "postgres", "nginx", "python3", "java",
+                                  "node", "systemd", "chrome (renderer)", "worker) odd"};
+    long page_kb = 4;
+    rss_kb = 0;
+
+    for (int i = 0; i < options.processes; i++) {
+        int pid = i + 1;
+        bool kernel = pid == 2 || pick(options.seed, pid, 2, 10) == 0;
+        char name[64];
+        if (kernel) {
+            snprintf(name, sizeof(name), "kworker/%d:%d", (int)pick(options.seed, pid, 3, options.cores), i % 4);
+        } else {
+            snprintf(name, sizeof(name), "%s", NAMES[pick(options.seed, pid, 3, sizeof(NAMES) / sizeof(NAMES[0]))]);
+        }
+        char state = kernel ? 'I' : STATES[pick(options.seed, pid, 4, sizeof(STATES) - 1)];
+
+        // CPU use in [0, 200)% of a core for a few, near idle for the rest
+        double cpu_share = pick(options.seed, pid, 5, 100) < 5 ? pick(options.seed, pid, 6, 200) / 100.0
+                                                                : pick(options.seed, pid, 6, 3) / 100.0;
+        double clock = 1000.0 + options.time;
+        uint64_t utime = (uint64_t)(clock * TICKS * cpu_share * 0.8);
+        uint64_t stime = (uint64_t)(clock * TICKS * cpu_share * 0.2);
+        uint64_t minflt = (uint64_t)(clock * pick(options.seed, pid, 7, 500));
+        uint64_t majflt = (uint64_t)(clock * pick(options.seed, pid, 8, 3));
+        uint64_t rss_pages = kernel ? 0 : 256 + pick(options.seed, pid, 9, 65536);
+        uint64_t vsize = kernel ? 0 : rss_pages * 4096 * 4;
+        uint64_t starttime = pick(options.seed, pid, 10, 100000);
+        long flags = kernel ? PF_KTHREAD : 0x00400000;
+        int ppid = kernel ? (pid == 2 ? 0 : 2) : (pid == 1 ? 0 : 1);
+        rss_kb += rss_pages * page_kb;
+
+        std::string directory = options.root + "/proc/" + std::to_string(pid);
+        if (!makeDirectories(directory)) {
+            perror(directory.c_str());
+            return false;
+        }
+        FILE* file = create(directory + "/stat");
+        if (!file) return false;
+        fprintf(file,
+                "%d (%s) %c %d %d %d 0 -1 %ld %llu 0 %llu 0 %llu %llu 0 0 20 0 1 0 %llu %llu %llu "
+                "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 %d 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+                pid, name, state, ppid, pid, pid, flags,
+                (unsigned long long)minflt, (unsigned long long)majflt,
+                (unsigned long long)utime, (unsigned long long)stime,
+                (unsigned long long)starttime, (unsigned long long)vsize, (unsigned long long)rss_pages,
+                (int)pick(options.seed, pid, 11, options.cores));
+        fclose(file);
+    }
+    return true;
+}
+
+static bool writeNetDev(const FixtureOptions& options) {
+    FILE* file = create(options.root + "/proc/net/dev");
+    if (!file) return false;
+    fputs("Inter-|   Receive                                                |  Transmit\n"
+          " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n",
+          file);
+    for (int i = 0; i <= options.interfaces; i++) {
+        char name[32];
+        if (i == 0) snprintf(name, sizeof(name), "lo");
+        else snprintf(name, sizeof(name), "eth%d", i - 1);
+        // Up to ~100 MB/s each way
+        double clock = 100000.0 + options.time;
+        uint64_t rx_rate = pick(options.seed, i, 12, 100000000);
+        uint64_t tx_rate = pick(options.seed, i, 13, 100000000);
+        uint64_t rx_bytes = (uint64_t)(clock * rx_rate), tx_bytes = (uint64_t)(clock * tx_rate);
+        fprintf(file, "%6s: %llu %llu 0 %llu 0 0 0 %llu %llu %llu 0 0 0 0 0 0\n", name,
+                (unsigned long long)rx_bytes, (unsigned long long)(rx_bytes / 1200),
+                (unsigned long long)(rx_bytes / 10000000), (unsigned long long)(rx_bytes / 100000),
+                (unsigned long long)tx_bytes, (unsigned long long)(tx_bytes / 1200));
+    }
+    fclose(file);
+    return true;
+}
+
+static bool writeSysfs(const FixtureOptions& options) {
+    char text[64];
+    for (int i = 0; i < options.sensors; i++) {
+        std::string directory = options.root + "/sys/class/hwmon/hwmon" + std::to_string(i);
+        if (!makeDirectories(directory)) return false;
+        snprintf(text, sizeof(text), "fixture%d\n", i);
+        writeText(directory + "/name", text);
+        snprintf(text, sizeof(text), "%d\n", 35000 + (int)pick(options.seed, i, 14, 50000));
+        writeText(directory + "/temp1_input", text);
+        snprintf(text, sizeof(text), "%d\n", 800 + (int)pick(options.seed, i, 15, 4000));
+        writeText(directory + "/fan1_input", text);
+        snprintf(text, sizeof(text), "%d\n", (int)pick(options.seed, i, 16, 256));
+        writeText(directory + "/pwm1", text);
+    }
+
+    std::string zone = options.root + "/sys/class/thermal/thermal_zone0";
+    std::string cooling = options.root + "/sys/class/thermal/cooling_device0";
+    if (!makeDirectories(zone) || !makeDirectories(cooling)) return false;
+    writeText(zone + "/type", "x86_pkg_temp\n");
+    snprintf(text, sizeof(text), "%d\n", 40000 + (int)pick(options.seed, 0, 17, 40000));
+    writeText(zone + "/temp", text);
+    writeText(cooling + "/type", "Processor\n");
+    writeText(cooling + "/cur_state", "0\n");
+    writeText(cooling + "/max_state", "10\n");
+    return true;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s --root DIR [--processes N] [--interfaces M] [--sensors K] [--cores C]\n"
+                    "       [--time SECONDS] [--seed S]\n", program);
+}
+
+int main(int argc, char** argv) {
+    FixtureOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--root") == 0) options.root = value;
+        else if (strcmp(argv[i], "--processes") == 0) options.processes = atoi(value);
+        else if (strcmp(argv[i], "--interfaces") == 0) options.interfaces = atoi(value);
+        else if (strcmp(argv[i], "--sensors") == 0) options.sensors = atoi(value);
+        else if (strcmp(argv[i], "--cores") == 0) options.cores = std::max(1, atoi(value));
+        else if (strcmp(argv[i], "--time") == 0) options.time = atof(value);
+        else if (strcmp(argv[i], "--seed") == 0) options.seed = strtoull(value, nullptr, 10);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (options.root.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!makeDirectories(options.root + "/proc/net") || !makeDirectories(options.root + "/proc/sys/kernel")) {
+        perror(options.root.c_str());
+        return 1;
+    }
+
+    uint64_t rss_kb = 0;
+    bool ok = writeText(options.root + "/proc/version", "Linux version 6.1.0-fixture (fixturegen)\n") &&
+              writeText(options.root + "/proc/sys/kernel/task_delayacct", "0\n") &&
+              writeCpuinfo(options) &&
+              writeProcStat(options) &&
+              writeProcesses(options, rss_kb) &&
+              writeMeminfo(options, rss_kb) &&
+              writeNetDev(options) &&
+              writeSysfs(options);
+    if (!ok) return 1;
+
+    printf("%s: %d processes, %d interfaces, %d sensors, %d cores at t=%.1f\n", options.root.c_str(),
+           options.processes, options.interfaces, options.sensors, options.cores, options.time);
+    return 0;
+}
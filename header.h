@@ -26,9 +26,18 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <sstream>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstring>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
@@ -68,29 +77,30 @@ struct Networks
     vector<IP4> ip4s;
 };
 
+// Kernel counters are 64-bit; a 32-bit field wraps after 2 GiB
 struct TX
 {
-    int bytes;
-    int packets;
-    int errs;
-    int drop;
-    int fifo;
-    int colls;
-    int carrier;
-    int compressed;
-    int multicast;
+    uint64_t bytes;
+    uint64_t packets;
+    uint64_t errs;
+    uint64_t drop;
+    uint64_t fifo;
+    uint64_t colls;
+    uint64_t carrier;
+    uint64_t compressed;
+    uint64_t multicast;
 };
 
 struct RX
 {
-    int bytes;
-    int packets;
-    int errs;
-    int drop;
-    int fifo;
-    int frame;
-    int compressed;
-    int multicast;
+    uint64_t bytes;
+    uint64_t packets;
+    uint64_t errs;
+    uint64_t drop;
+    uint64_t fifo;
+    uint64_t frame;
+    uint64_t compressed;
+    uint64_t multicast;
 };
 
 struct ProcessStats {
@@ -101,48 +111,1331 @@ struct ProcessStats {
     long long int starttime;
     long long int vsize;
     long long int rss;
+    long long int minflt;
+    long long int majflt;
 };
 
+// Every field of /proc/[pid]/stat, in the order proc(5) documents them.
+// Signal masks and addresses are stored bit-for-bit in the signed fields.
+struct ProcStat {
+    long long pid;
+    char comm[64];
+    char state;
+    long long ppid;
+    long long pgrp;
+    long long session;
+    long long tty_nr;
+    long long tpgid;
+    long long flags;
+    long long minflt;
+    long long cminflt;
+    long long majflt;
+    long long cmajflt;
+    long long utime;
+    long long stime;
+    long long cutime;
+    long long cstime;
+    long long priority;
+    long long nice;
+    long long num_threads;
+    long long itrealvalue;
+    long long starttime;
+    long long vsize;
+    long long rss;
+    long long rsslim;
+    long long startcode;
+    long long endcode;
+    long long startstack;
+    long long kstkesp;
+    long long kstkeip;
+    long long signal;
+    long long blocked;
+    long long sigignore;
+    long long sigcatch;
+    long long wchan;
+    long long nswap;
+    long long cnswap;
+    long long exit_signal;
+    long long processor;
+    long long rt_priority;
+    long long policy;
+    long long delayacct_blkio_ticks;
+    long long guest_time;
+    long long cguest_time;
+    long long start_data;
+    long long end_data;
+    long long start_brk;
+    long long arg_start;
+    long long arg_end;
+    long long env_start;
+    long long env_end;
+    long long exit_code;
+};
+
+// Decodes one /proc/[pid]/stat line without allocating. comm is taken up to
+// the last ')' so names containing spaces or parentheses parse correctly.
+// Fields missing on older kernels are left 0.
+bool parseProcStat(const char* text, size_t length, ProcStat& stat);
+
 struct ProcessMetrics {
-    float cpu_usage;
-    float mem_usage;
+    float cpu_usage;        // % of one core (can exceed 100 for multithreaded processes)
+    float cpu_host;         // % of all online cores
+    float child_cpu;        // % of one core spent by children reaped during the interval
+    float minflt_rate;      // minor faults per second
+    float majflt_rate;      // major faults per second
+    float mem_usage;        // RSS as % of MemTotal
+    static bool readProcessStat(pid_t pid, ProcStat& stat);
     static ProcessStats getProcessStats(pid_t pid);
-    static ProcessMetrics getProcessMetrics(
-        const ProcessStats& current,
-        const ProcessStats& last,
-        unsigned long uptime
-    );
+    static ProcessStats getProcessStats(const ProcStat& stat);
+};
+
+// Turns two samples of one process into per-second rates. Intervals come
+// from CLOCK_MONOTONIC, so they are immune to wall clock steps.
+class ProcessAccounting {
+private:
+    double clk_tck = 100.0;
+    double page_size = 4096.0;
+    int cpu_count = 1;
+    double total_memory = 0.0;
+
+public:
+    // Refresh the host constants; called once per scan
+    void refresh(size_t total_memory);
+    ProcessMetrics compute(const ProcessStats& current,
+                           const ProcessStats& previous,
+                           double elapsed) const;
+};
+
+// Seconds on CLOCK_MONOTONIC; while a capture is replayed, the recorded
+// reading on the collector thread
+double monotonicSeconds();
+
+// Cumulative per-thread-group counters from taskstats, in ns and bytes
+struct TaskCounters {
+    uint64_t cpu_delay;         // waiting on a run queue
+    uint64_t blkio_delay;       // waiting for block I/O
+    uint64_t swapin_delay;      // waiting for swap-in
+    uint64_t read_bytes;        // storage I/O actually issued
+    uint64_t write_bytes;
+};
+
+// Taskstats counters turned into rates; delays are % of wall time
+struct TaskDelayMetrics {
+    bool valid;
+    float cpu_delay;
+    float blkio_delay;
+    float swapin_delay;
+    float read_rate;            // bytes per second
+    float write_rate;
+};
+
+// Generic netlink client for the kernel's TASKSTATS family. One socket
+// answers TASKSTATS_CMD_GET queries in batches; a second one is registered
+// as the exit listener on every possible CPU and receives each task's final
+// counters when it exits. Needs CAP_NET_ADMIN.
+class TaskstatsClient {
+private:
+    int sock = -1;
+    int exit_sock = -1;
+    uint16_t family = 0;
+    uint32_t sequence = 0;
+    std::vector<char> buffer;
+    std::vector<uint8_t> exit_record;   // collectExits() scratch, per tgid
+
+public:
+    ~TaskstatsClient();
+    bool open();
+    void close();
+    bool available() const { return sock >= 0; }
+
+    // Fetches counters for every tgid in one pipelined round of requests.
+    // found[i] is false for pids that exited or could not be queried.
+    void query(const std::vector<pid_t>& tgids,
+               std::vector<TaskCounters>& counters,
+               std::vector<bool>& found);
+
+    // Reads every queued exit record. A tgid in tgids (sorted) that query()
+    // did not find but that exited since the last call gets its final
+    // counters, so the last interval before it leaves the table is counted.
+    void collectExits(const std::vector<pid_t>& tgids,
+                      std::vector<TaskCounters>& counters,
+                      std::vector<bool>& found);
 };
 
+// Whether the kernel is collecting delay accounting (kernel.task_delayacct)
+bool delayAccountingEnabled();
+
 struct ProcessInfo {
     pid_t pid;
-    std::string name;
-    std::string state;
-    float cpu_usage;
-    float mem_usage;
-    bool selected;
+    char name[64];          // comm; a fixed buffer, so publishing a row never allocates
+    char state;             // single-letter state from /proc/[pid]/stat
+    bool kernel_thread;
+    ProcessMetrics metrics;
     ProcessStats last_stats;
+    double sampled_at;      // monotonicSeconds() when last_stats was read
+    TaskDelayMetrics delay; // only filled for watched pids
+};
+
+// State histogram over every task in /proc, kernel threads included
+struct SystemProcessStats {
+    int total = 0;
+    int running = 0;
+    int sleeping = 0;
+    int disk_sleep = 0;
+    int zombie = 0;
+    int stopped = 0;
+    int idle = 0;
+
+    void count(char state);
+};
+
+// Output of one /proc scan, shared by the System and Processes windows
+struct ProcessSnapshot {
+    SystemProcessStats stats;
+    std::vector<ProcessInfo> rows;     // table order; readers sort what they show
+    bool event_driven = false;  // table maintained from proc connector events
+    bool taskstats_available = false;
+    bool delayacct_enabled = false;
+    uint32_t scan = 0;          // the scan that built rows; equal scans mean equal rows
+};
+
+// "S (sleeping)" style label for a /proc/[pid]/stat state letter
+const char* describeProcessState(char state);
+
+// Identifies one process incarnation: a recycled pid gets a new starttime
+struct ProcessKey {
+    pid_t pid;
+    long long starttime;
+
+    bool operator==(const ProcessKey& other) const {
+        return pid == other.pid && starttime == other.starttime;
+    }
+};
+
+// Open-addressing hash map from ProcessKey to V. Linear probing with
+// backward-shift deletion leaves no tombstones, and the slot array shrinks
+// again when the live set does, so memory follows the number of live pids.
+template <typename V>
+class ProcessTable {
+private:
+    struct Slot {
+        bool used = false;
+        ProcessKey key;
+        V value;
+    };
+
+    std::vector<Slot> slots;
+    size_t live = 0;
+    static constexpr size_t MIN_CAPACITY = 256;
+
+    size_t home(const ProcessKey& key) const {
+        uint64_t h = (uint64_t)key.pid * 0x9E3779B97F4A7C15ull ^ (uint64_t)key.starttime;
+        h ^= h >> 29;
+        return h & (slots.size() - 1);
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(capacity);
+        live = 0;
+        for (Slot& slot : old) {
+            if (slot.used) insert(slot.key) = std::move(slot.value);
+        }
+    }
+
+public:
+    size_t size() const { return live; }
+    size_t capacity() const { return slots.size(); }
+
+    V* find(const ProcessKey& key) {
+        if (slots.empty()) return nullptr;
+        for (size_t i = home(key); slots[i].used; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].key == key) return &slots[i].value;
+        }
+        return nullptr;
+    }
+
+    // Returns the existing value, or a default-constructed one for a new key
+    V& insert(const ProcessKey& key, bool* inserted = nullptr) {
+        if ((live + 1) * 2 > slots.size()) {
+            rehash(std::max(MIN_CAPACITY, slots.size() * 2));
+        }
+        size_t i = home(key);
+        for (; slots[i].used; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].key == key) {
+                if (inserted) *inserted = false;
+                return slots[i].value;
+            }
+        }
+        slots[i].used = true;
+        slots[i].key = key;
+        slots[i].value = V();
+        live++;
+        if (inserted) *inserted = true;
+        return slots[i].value;
+    }
+
+    void erase(const ProcessKey& key) {
+        if (slots.empty()) return;
+        size_t mask = slots.size() - 1;
+        size_t hole = home(key);
+        while (slots[hole].used && !(slots[hole].key == key)) hole = (hole + 1) & mask;
+        if (!slots[hole].used) return;
+
+        // Pull later members of the probe run back into the hole
+        for (size_t next = (hole + 1) & mask; slots[next].used; next = (next + 1) & mask) {
+            size_t want = home(slots[next].key);
+            bool movable = (hole <= next) ? (want <= hole || want > next)
+                                          : (want <= hole && want > next);
+            if (movable) {
+                slots[hole] = std::move(slots[next]);
+                hole = next;
+            }
+        }
+        slots[hole].used = false;
+        slots[hole].value = V();
+        live--;
+
+        if (slots.size() > MIN_CAPACITY && live * 8 < slots.size()) {
+            rehash(slots.size() / 2);
+        }
+    }
+
+    template <typename F>
+    void forEach(F visit) {
+        for (Slot& slot : slots) {
+            if (slot.used) visit(slot.key, slot.value);
+        }
+    }
 };
 
+// Fork/exec/exit notifications from the kernel's proc connector
+// (NETLINK_CONNECTOR, CN_IDX_PROC). Subscribing needs CAP_NET_ADMIN; when
+// open() fails the caller keeps polling /proc instead.
+class ProcEventListener {
+private:
+    int sock = -1;
+
+public:
+    ~ProcEventListener();
+    bool open();
+    void close();
+    bool available() const { return sock >= 0; }
+
+    // Drains queued events without blocking, appending process (not thread)
+    // pids. Returns false if the kernel dropped events, which means the
+    // caller's view is stale and needs a full rescan.
+    bool poll(std::vector<pid_t>& forked, std::vector<pid_t>& exited);
+};
+
+// update() runs on the collector thread, render() and the filter/selection
+// helpers on the UI thread; the two sides only meet through the snapshot.
 class ProcessManager {
 public:
     char filter[256];
+    std::atomic<bool> show_kernel_threads{false};   // rows are only built for them when set
+    std::atomic<bool> show_delay_accounting{false}; // taskstats are only fetched when set
 private:
-    std::vector<ProcessInfo> processes;
+    struct TrackedProcess {
+        ProcessInfo info;
+        uint32_t seen_in_scan = 0;
+        TaskCounters task_counters;
+        double task_sampled_at = 0.0;   // 0 until the first taskstats sample
+    };
+
     std::vector<pid_t> selected_pids;
-    std::map<pid_t, ProcessStats> last_stats;
-    float last_update_time;
+    ProcessAccounting accounting;
+    ProcessTable<TrackedProcess> table;     // persists across scans
+    uint32_t scan = 0;
+
+    // With proc events the pid list comes from the table plus forks instead
+    // of readdir(/proc); a full rescan still runs now and then to reconcile
+    ProcEventListener events;
+    bool events_tried = false;
+    bool rescan_needed = true;
+    double last_full_scan = 0.0;
+
+    // Taskstats are only fetched for the pids the UI shows or has selected,
+    // which render() hands over through watched_pids
+    TaskstatsClient taskstats;
+    bool taskstats_tried = false;
+    std::mutex watch_mutex;
+    std::vector<pid_t> watched_pids;        // guarded by watch_mutex
+    std::vector<pid_t> visible_pids;        // UI thread scratch
+
+    // Scratch lists, reused every scan
+    std::vector<pid_t> watched;
+    std::vector<TaskCounters> task_counters;
+    std::vector<bool> task_found;
+    std::vector<pid_t> pending;
+    std::vector<pid_t> forked;
+    std::vector<pid_t> exited_pids;
+    std::vector<ProcessKey> exited;
+
+    // UI thread: indexes of the rows that pass the filter, in display order.
+    // Rebuilt only when the rows, the filter or the sort order change, so a
+    // frame only pays for the rows the clipper shows.
+    std::vector<uint32_t> view;
+    uint32_t view_scan = 0;
+    bool view_dirty = true;
+    int sort_column = 0;
+    bool sort_descending = true;
+
+    void sampleProcess(pid_t pid, ProcessSnapshot& snapshot, bool want_kernel_threads);
+    void sampleTaskstats(ProcessSnapshot& snapshot);
+    void rebuildView(const ProcessSnapshot& snapshot);
 
 public:
-    void update();
-    void render();
+    void update(ProcessSnapshot& snapshot, size_t total_memory);
+    void render(const ProcessSnapshot& snapshot);
+    // Hands the collector the pids to fetch taskstats for; takes pids' contents
+    void watch(std::vector<pid_t>& pids);
     bool matchesFilter(const ProcessInfo& proc);
-    void handleSelection(ProcessInfo& proc);
+    bool isSelected(pid_t pid) const;
+    void handleSelection(pid_t pid);
+};
+
+// System information structures
+struct SystemInfo {
+    std::string os_type;
+    std::string logged_user;
+    std::string hostname;
+    std::string cpu_model;
+};
+
+// Fixed-capacity ring buffer of timestamped samples; the oldest sample is
+// overwritten once it is full. Values stay in one array so PlotLines can
+// draw the ring without a copy:
+//   ImGui::PlotLines(label, series.values(), series.size(), series.offset(), ...)
+template <typename T>
+class TimeSeries {
+private:
+    std::vector<T> value_ring;
+    std::vector<double> time_ring;
+    size_t head = 0;        // slot the next sample goes into
+    size_t count = 0;
+
+public:
+    explicit TimeSeries(size_t capacity = 100) : value_ring(capacity), time_ring(capacity) {}
+
+    size_t capacity() const { return value_ring.size(); }
+    int size() const { return (int)count; }
+    bool empty() const { return count == 0; }
+
+    // Base pointer and values_offset for ImGui::PlotLines
+    const T* values() const { return value_ring.data(); }
+    int offset() const { return count < capacity() ? 0 : (int)head; }
+
+    // i = 0 is the oldest sample
+    const T& operator[](size_t i) const { return value_ring[(offset() + i) % capacity()]; }
+    double timeAt(size_t i) const { return time_ring[(offset() + i) % capacity()]; }
+    const T& latest() const { return value_ring[(head + capacity() - 1) % capacity()]; }
+
+    void push(double time, const T& value) {
+        value_ring[head] = value;
+        time_ring[head] = time;
+        head = (head + 1) % capacity();
+        if (count < capacity()) count++;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    // Keeps the newest samples that still fit
+    void setCapacity(size_t new_capacity) {
+        if (new_capacity == 0 || new_capacity == capacity()) return;
+        size_t keep = std::min((size_t)count, new_capacity);
+        std::vector<T> values(new_capacity);
+        std::vector<double> times(new_capacity);
+        for (size_t i = 0; i < keep; i++) {
+            values[i] = (*this)[count - keep + i];
+            times[i] = timeAt(count - keep + i);
+        }
+        value_ring.swap(values);
+        time_ring.swap(times);
+        count = keep;
+        head = keep % new_capacity;
+    }
+};
+
+// Aggregate of the samples that fell into one rollup bucket
+struct RollupPoint {
+    float min;
+    float max;
+    float avg;
+    float last;
+};
+
+// Time spans a graph can show; each reads the coarsest tier that still
+// has enough points for it
+enum HistorySpan {
+    SPAN_LIVE,      // raw samples, last few minutes
+    SPAN_HOUR,      // 10 s buckets
+    SPAN_DAY,       // 1 min buckets
+    SPAN_WEEK,      // 1 h buckets
+    SPAN_COUNT
+};
+
+// History of one metric: raw samples for a short window, cascading into
+// min/max/avg/last rollups of 10 s, 1 min and 1 h. Each tier is a ring,
+// so memory is fixed (about 55 KB per metric for a week).
+class MetricHistory {
+public:
+    static const int TIER_COUNT = 3;
+
+    MetricHistory();
+    void push(double time, float value);
+
+    uint32_t id = 0;            // unique within the store, never reused; used by the journal
+
+    const TimeSeries<float>& rawSamples() const { return raw; }
+    const TimeSeries<RollupPoint>& tier(int index) const { return tiers[index]; }
+
+private:
+    struct Bucket {
+        double start = 0.0;
+        float min = 0.0f, max = 0.0f, last = 0.0f;
+        double sum = 0.0;
+        uint32_t count = 0;     // raw samples folded in
+    };
+
+    TimeSeries<float> raw;
+    TimeSeries<RollupPoint> tiers[TIER_COUNT];
+    Bucket pending[TIER_COUNT];     // buckets still being filled
+
+    void accumulate(int tier, double time, float min, float max, double sum, float last, uint32_t count);
+};
+
+// What plotHistory() drew, for callers that annotate the graph
+struct HistoryView {
+    int count;
+    float latest;
+    float peak;         // highest sample (or bucket max) in the span
+    int peak_index;
+    float scale_max;
+};
+
+// All graph histories, kept outside the published snapshots so retention
+// costs nothing per publish. The collector records, the UI reads; both go
+// through the store's mutex.
+class MetricJournal;
+
+class HistoryStore {
+private:
+    typedef std::map<std::string, MetricHistory> MetricMap;
+
+    // A released metric, kept alive until no published snapshot can still
+    // point at it
+    struct Retired {
+        double released_at;     // real CLOCK_MONOTONIC, also during a replay
+        MetricMap::node_type node;
+    };
+
+    std::mutex mutex;
+    MetricMap metrics;                              // nodes never move
+    std::unordered_map<uint32_t, const std::string*> names;    // by MetricHistory::id
+    std::vector<Retired> retired;
+    std::unordered_set<uint32_t> unclaimed;         // restored, not yet asked for by name
+    uint32_t next_id = 0;
+    std::atomic<MetricJournal*> journal{nullptr};
+
+    MetricHistory* obtain(const std::string& name);
+    void detach(MetricMap::iterator found, double now);
+    void freeRetired(double now);
+
+public:
+    // Returns the named metric, creating it on first use. The pointer stays
+    // valid until the metric is released, and for RELEASE_GRACE after that.
+    MetricHistory* metric(const std::string& name);
+    // The journal's variant: a metric it creates stays unclaimed until
+    // metric() asks for it, and releaseUnclaimed() drops it otherwise
+    MetricHistory* restoredMetric(const std::string& name);
+    // The named metric if it exists; never creates one
+    MetricHistory* find(const std::string& name);
+    bool metricName(uint32_t id, std::string& name);
+    // Drops a metric whose source is gone, such as a removed interface. If
+    // the name comes back within the grace period it keeps its history.
+    void release(const std::string& name);
+    // Called once every collector has sampled: releases restored metrics
+    // whose source no longer exists
+    void releaseUnclaimed();
+
+    // Adds a sample and hands it to the journal, if one is attached
+    void record(MetricHistory* metric, double time, float value);
+    // Adds a sample read back from the journal
+    void restore(MetricHistory* metric, double time, float value);
+    void attachJournal(MetricJournal* sink) { journal = sink; }
+
+    friend HistoryView plotHistory(const char*, const MetricHistory*, HistorySpan,
+                                   const char*, float, ImVec2, float);
+};
+
+extern HistoryStore g_history;
+
+// Lock-free queue between exactly one producer and one consumer thread.
+// Capacity is a power of two; push() fails instead of blocking when full.
+template <typename T>
+class SpscQueue {
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};   // next slot to read, consumer owned
+    alignas(64) std::atomic<size_t> tail{0};   // next slot to write, producer owned
+
+public:
+    explicit SpscQueue(size_t capacity_log2) : slots((size_t)1 << capacity_log2), mask(slots.size() - 1) {}
+
+    bool push(const T& value) {
+        size_t write = tail.load(std::memory_order_relaxed);
+        if (write - head.load(std::memory_order_acquire) == slots.size()) return false;
+        slots[write & mask] = value;
+        tail.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t read = head.load(std::memory_order_relaxed);
+        if (read == tail.load(std::memory_order_acquire)) return false;
+        value = slots[read & mask];
+        head.store(read + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Append-only on-disk copy of every recorded sample, so history survives a
+// restart or reboot. Samples go through an SpscQueue to a writer thread that
+// appends fixed-size checksummed records to an mmap'ed segment file; the
+// sampling path never touches the disk. Segments rotate when their records
+// or their schema run out, and are deleted once they hold nothing from the
+// last week. See journal.cpp for the file format.
+class MetricJournal {
+public:
+    ~MetricJournal();
+
+    // Replays the existing segments in directory into g_history, then resumes
+    // appending to the newest one, or starts a new segment if it is full or
+    // damaged, and starts the writer thread. Returns false if the directory is
+    // unusable; the monitor then runs without a journal.
+    bool open(const std::string& directory);
+    void close();
+
+    // Collector thread; drops the sample if the writer has fallen behind
+    void append(uint32_t metric, double time, float value);
+
+    size_t restoredRecords() const { return restored; }
+    size_t droppedRecords() const { return dropped; }
+
+private:
+    struct Pending {
+        double time;        // monotonicSeconds()
+        uint32_t metric;
+        float value;
+    };
+
+    std::string directory;
+    SpscQueue<Pending> queue{16};
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+
+    // Writer thread state
+    int fd = -1;
+    char* mapping = nullptr;
+    uint64_t segment_sequence = 0;
+    size_t next_record = 0;
+    std::unordered_map<uint32_t, uint32_t> segment_ids;    // store metric id to id in this segment
+    uint32_t schema_written = 0;    // segment ids handed out, each named in the header
+    double wall_offset = 0.0;       // CLOCK_REALTIME - CLOCK_MONOTONIC
+
+    size_t restored = 0;
+    std::atomic<size_t> dropped{0};
+    bool drop_reported = false;     // writer thread
+
+    void replay();
+    bool resumeSegment();
+    bool startSegment();
+    void finishSegment();
+    void removeOldSegments();
+    bool segmentId(uint32_t metric, uint32_t& id);
+    void drain();
+    void run();
+};
+
+extern MetricJournal g_journal;
+
+// Draws one span of a metric with PlotLines; tiers plot their bucket
+// averages. A scale_max of 0 scales to 110% of the span's peak, but never
+// below auto_floor.
+HistoryView plotHistory(const char* label, const MetricHistory* metric, HistorySpan span,
+                        const char* overlay, float scale_max, ImVec2 size,
+                        float auto_floor = 0.0f);
+void renderSpanSelector(const char* label, HistorySpan& span);
+
+// The columns of a /proc/stat cpu line, in order. guest and guest_nice are
+// already included in user and nice, so they are not part of the total.
+enum CPUState {
+    CPU_USER,
+    CPU_NICE,
+    CPU_SYSTEM,
+    CPU_IDLE,
+    CPU_IOWAIT,
+    CPU_IRQ,
+    CPU_SOFTIRQ,
+    CPU_STEAL,
+    CPU_GUEST,
+    CPU_GUEST_NICE,
+    CPU_STATE_COUNT
+};
+
+const char* describeCPUState(CPUState state);
+
+// Shares of the last sample interval, in percent. Per-core values are kept
+// as one array per state (structure of arrays), indexed like core_ids, so
+// drawing or exporting one state walks a single contiguous array.
+struct CPUData {
+    float current_usage = 0.0f;                 // busy % over all cores
+    float states[CPU_STATE_COUNT] = {};         // aggregate breakdown
+    std::vector<int> core_ids;                  // N of each cpuN line; offline cores have none
+    std::vector<float> core_usage;              // busy % per core
+    std::vector<float> core_states[CPU_STATE_COUNT];
+};
+
+// Per-core /proc/stat deltas (cpudelta.cpp). Per row, shares[state] =
+// delta * 100 / total and busy = (total - idle - iowait) * 100 / total; total
+// leaves out guest time, a counter that went backwards counts as 0, and
+// deltas must stay below 2^52 ticks.
+struct CPUDeltaColumns {
+    const uint64_t* current[CPU_STATE_COUNT];
+    const uint64_t* previous[CPU_STATE_COUNT];
+    float* shares[CPU_STATE_COUNT];
+    float* busy;
+    size_t count;
+};
+
+enum CPUDeltaKernel {
+    CPU_DELTA_SCALAR,       // reference
+    CPU_DELTA_SSE2,         // 2 rows per step
+    CPU_DELTA_AVX2,         // 4 rows per step
+};
+
+// The widest kernel this CPU and OS support, checked once with cpuid
+CPUDeltaKernel bestCPUDeltaKernel();
+const char* describeCPUDeltaKernel(CPUDeltaKernel kernel);
+// Every kernel gives bit-identical results
+void computeCPUDeltas(const CPUDeltaColumns& columns, CPUDeltaKernel kernel);
+
+enum FanSource {
+    FAN_SOURCE_NONE,
+    FAN_SOURCE_DIRECT,      // /proc/acpi/ibm/fan
+    FAN_SOURCE_HWMON,       // /sys/class/hwmon/*/fan*_input
+    FAN_SOURCE_COOLING      // /sys/class/thermal/cooling_device*
+};
+
+struct FanData {
+    FanSource source = FAN_SOURCE_NONE;
+    bool enabled = false;
+    int speed = 0;
+    int level = 0;
+};
+
+struct ThermalData {
+    float current_temp = 0.0f;
 };
 
+// Directory that /proc and /sys paths resolve under (--root DIR), so the
+// collectors can run against a fixture tree; empty means the real root.
+// Paths stay "/proc/..." everywhere else, including in captures.
+void setKernelRoot(const std::string& root);
+const std::string& kernelRoot();
+// path itself without a root, else root + path written into resolved
+const char* resolveKernelPath(const char* path, char (&resolved)[PATH_MAX]);
+// Netlink only describes the live host: off under a root or a capture
+bool netlinkSourcesEnabled();
+
+// A fixed-path kernel file (/proc/stat, a hwmon input...) kept open between
+// samples. read() re-reads it with pread(fd, buf, n, 0) into a buffer owned by
+// the object and reopens transparently if the file went away underneath us.
+// Reads are recorded or replayed when g_capture is open.
+class KernelFile {
+private:
+    std::string path;
+    int fd = -1;
+    std::vector<char> buffer;
+
+    bool reopen();
+    const char* readLive(size_t& length);
+    const char* replay(size_t& length);
+
+public:
+    explicit KernelFile(const std::string& path);
+    ~KernelFile();
+    KernelFile(const KernelFile&) = delete;
+    KernelFile& operator=(const KernelFile&) = delete;
+
+    // NUL-terminated contents, valid until the next read(); nullptr on failure
+    const char* read(size_t* length = nullptr);
+};
+
+// KernelFile per path, for sensor files discovered at runtime
+class KernelFileCache {
+private:
+    std::map<std::string, KernelFile> files;
+
+public:
+    const char* read(const std::string& path, size_t* length = nullptr);
+    void forget(const std::string& path);
+};
+
+// readdir() through the capture. next() returns entry names ("." and ".."
+// included, as readdir does), valid until the following call.
+class KernelDirectory {
+private:
+    DIR* dir = nullptr;
+    std::string listing;            // recording: every name, NUL-terminated
+    const char* replay_next = nullptr;  // recorded names still to return
+    const char* replay_end = nullptr;
+
+public:
+    explicit KernelDirectory(const char* path);
+    ~KernelDirectory();
+    KernelDirectory(const KernelDirectory&) = delete;
+    KernelDirectory& operator=(const KernelDirectory&) = delete;
+
+    bool isOpen() const { return dir || replay_next; }
+    const char* next();
+};
+
+// access(path, mode) == 0, through the capture
+bool kernelPathExists(const char* path, int mode = F_OK);
+
+// Every /proc/meminfo field we know about, in kB as the kernel reports them
+// (HugePages_* are page counts). Fields missing on this kernel stay 0.
+struct MemInfo {
+    size_t mem_total = 0;
+    size_t mem_free = 0;
+    size_t mem_available = 0;
+    size_t buffers = 0;
+    size_t cached = 0;
+    size_t swap_cached = 0;
+    size_t active = 0;
+    size_t inactive = 0;
+    size_t active_anon = 0;
+    size_t inactive_anon = 0;
+    size_t active_file = 0;
+    size_t inactive_file = 0;
+    size_t unevictable = 0;
+    size_t mlocked = 0;
+    size_t swap_total = 0;
+    size_t swap_free = 0;
+    size_t dirty = 0;
+    size_t writeback = 0;
+    size_t anon_pages = 0;
+    size_t mapped = 0;
+    size_t shmem = 0;
+    size_t kreclaimable = 0;
+    size_t slab = 0;
+    size_t sreclaimable = 0;
+    size_t sunreclaim = 0;
+    size_t kernel_stack = 0;
+    size_t page_tables = 0;
+    size_t commit_limit = 0;
+    size_t committed_as = 0;
+    size_t vmalloc_used = 0;
+    size_t anon_huge_pages = 0;
+    size_t hugepages_total = 0;
+    size_t hugepages_free = 0;
+    size_t hugepages_rsvd = 0;
+    size_t hugepages_surp = 0;
+    size_t hugepagesize = 0;
+    size_t hugetlb = 0;
+};
+
+// Reads /proc/meminfo into a reusable buffer and fills every MemInfo field
+// in a single pass. Not thread safe; give each thread its own reader.
+class MemInfoReader {
+private:
+    KernelFile file{"/proc/meminfo"};
+    size_t next_key = 0;    // table slot expected on the next line
+
+public:
+    bool sample(MemInfo& info);
+};
+
+struct RAMStatus {
+    size_t total = 0;
+    size_t used = 0;
+    size_t free = 0;
+    float usage_percent = 0.0f;
+
+    void update(const MemInfo& info);
+    void render() const;
+};
+
+struct SwapStatus {
+    size_t total = 0;
+    size_t used = 0;
+    size_t free = 0;
+    float usage_percent = 0.0f;
+
+    void update(const MemInfo& info);
+    void render() const;
+};
+
+struct DiskStatus {
+    size_t total = 0;
+    size_t used = 0;
+    size_t available = 0;
+    float usage_percent = 0.0f;
+
+    void update();
+    void render() const;
+};
+
+// Per-second rates over the last sample interval
+struct InterfaceRates {
+    float rx_bytes, tx_bytes;
+    float rx_packets, tx_packets;
+    float rx_errors, tx_errors;
+    float rx_drops, tx_drops;
+};
+
+// Network interface data structure
+struct NetworkInterface {
+    std::string name;        // e.g., "lo", "wlp5s0"
+    std::string ipv4;        // IPv4 address, empty when there is none
+    int index = 0;           // kernel ifindex, 0 when read from /proc/net/dev
+    bool seen = false;       // collector bookkeeping: present in the last sample
+
+    // RX Statistics
+    RX rx;
+    // TX Statistics
+    TX tx;
+
+    // Rates from the difference to the previous sample
+    InterfaceRates rates{};
+    RX previous_rx{};
+    TX previous_tx{};
+    double sampled_at = 0.0; // monotonicSeconds() of previous_rx/tx, 0 before the first
+
+    // Throughput history in bytes per second, in g_history
+    MetricHistory* rx_history = nullptr;
+    MetricHistory* tx_history = nullptr;
+};
+
+// Everything the windows draw, grouped by the window that draws it
+struct SystemSnapshot {
+    SystemInfo info;
+    CPUData cpu;
+    FanData fan;
+    ThermalData thermal;
+};
+
+struct MemorySnapshot {
+    MemInfo meminfo;
+    RAMStatus ram;
+    SwapStatus swap;
+    DiskStatus disk;
+};
+
+struct NetworkSnapshot {
+    std::vector<NetworkInterface> interfaces;
+    bool rtnetlink = false;  // counters came from an RTM_GETLINK dump
+};
+
+// Collectors the scheduler runs independently, each at its own rate
+enum SampleTask {
+    TASK_SYSTEM_INFO,
+    TASK_CPU,
+    TASK_FAN,
+    TASK_THERMAL,
+    TASK_MEMORY,
+    TASK_DISK,
+    TASK_PROCESSES,
+    TASK_NETWORK,
+    TASK_COUNT
+};
+
+const char* describeSampleTask(SampleTask task);
+
+// Record and replay of the collector's kernel reads (--record FILE,
+// --replay FILE). While a task runs on the collector thread, every /proc and
+// /sys file, directory listing, clock reading and the few other host values
+// it uses pass through g_capture: recording appends them to one frame per
+// task run, replaying hands the recorded bytes back in the same order, so
+// the same parsers see the same input. Netlink sources (rtnetlink, proc
+// connector, taskstats) are not byte streams and stay off while a capture is
+// open; the collectors use their /proc fallbacks instead. See capture.cpp.
+enum CaptureKind : uint8_t {
+    CAPTURE_PATH,           // defines a path id; the data is the path
+    CAPTURE_FILE,           // contents of a file
+    CAPTURE_DIRECTORY,      // entry names, each NUL-terminated
+    CAPTURE_EXISTS,         // access() result, no data
+    CAPTURE_VALUE,          // anything else, e.g. "@hostname"
+    CAPTURE_CLOCK,          // one monotonicSeconds() reading
+};
+
+class KernelCapture {
+public:
+    enum Mode { LIVE, RECORD, REPLAY };
+
+    ~KernelCapture();
+    bool openRecording(const std::string& path);
+    bool openReplay(const std::string& path, double speed);
+    void close();
+
+    Mode mode() const { return capture_mode; }
+    double speed() const { return replay_speed; }
+    // Replay: when the current frame's task started
+    double taskTime() const { return frame_time; }
+    // On the collector thread inside a task of an open capture
+    bool recording() const { return in_task && capture_mode == RECORD; }
+    bool replaying() const { return in_task && capture_mode == REPLAY; }
+
+    // Replay: loads the next frame; false at the end of the capture
+    bool nextTask(SampleTask& task, double& time);
+    // Bracket one task run; recording writes the frame in endTask()
+    void beginTask(SampleTask task);
+    void endTask();
+
+    // Replay: the next recorded result for path. Returns false if nothing
+    // matches; *data is nullptr if the original read failed.
+    bool fetch(CaptureKind kind, const char* path, const char** data, size_t* length);
+    // Record: data nullptr means the read failed
+    void store(CaptureKind kind, const char* path, const void* data, size_t length);
+
+    // String convenience for CAPTURE_VALUE
+    bool replayValue(const char* name, std::string& value);
+    void recordValue(const char* name, const std::string& value);
+
+private:
+    struct Entry {
+        CaptureKind kind;
+        bool ok;
+        bool used;
+        uint32_t path;
+        const char* data;
+        uint32_t length;
+    };
+
+    Mode capture_mode = LIVE;
+    double replay_speed = 1.0;
+    static thread_local bool in_task;
+
+    // Recording
+    int fd = -1;
+    std::map<std::string, uint32_t, std::less<>> path_ids;
+    std::vector<char> frame;
+    uint32_t frame_entries = 0;
+    double frame_time = 0.0;
+
+    // Replay: the whole file mapped, frames decoded one at a time
+    const char* mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t offset = 0;
+    std::vector<std::string> paths;
+    std::vector<Entry> entries;
+    size_t cursor = 0;
+
+    uint32_t pathId(const char* path);
+    void appendEntry(CaptureKind kind, bool ok, uint32_t path, const void* data, size_t length);
+};
+
+extern KernelCapture g_capture;
+
+// How a collector has kept up with its schedule
+struct TaskStats {
+    float rate = 0.0f;              // Hz currently configured
+    uint64_t runs = 0;
+    uint64_t missed = 0;            // whole periods skipped because the run came late
+    float worst_lateness = 0.0f;    // seconds past the deadline
+    float last_duration = 0.0f;     // seconds the last run took
+};
+
+struct SchedulerSnapshot {
+    TaskStats tasks[TASK_COUNT];
+};
+
+struct MonitorSnapshot {
+    uint64_t sequence = 0;
+    SystemSnapshot system;
+    MemorySnapshot memory;
+    ProcessSnapshot processes;
+    NetworkSnapshot network;
+    SchedulerSnapshot scheduler;
+};
+
+// Triple buffer between one writer and one reader. The writer fills back()
+// and publish()es it; the reader acquire()s the newest published slot and
+// keeps reading front() until its next acquire(). Neither side ever blocks
+// and the slot behind front() is never touched by the writer.
+template <typename T>
+class SnapshotBuffer {
+private:
+    static const unsigned FRESH = 4;    // set on `middle` by publish(), cleared by acquire()
+
+    T slots[3];
+    unsigned back_index = 0;            // writer only
+    unsigned front_index = 1;           // reader only
+    std::atomic<unsigned> middle{2};
+
+public:
+    T& back() { return slots[back_index]; }
+    const T& front() const { return slots[front_index]; }
+
+    void publish() {
+        unsigned previous = middle.exchange(back_index | FRESH, std::memory_order_acq_rel);
+        back_index = previous & ~FRESH;
+    }
+
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        unsigned previous = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & ~FRESH;
+        return true;
+    }
+};
+
+// Sampling entry points, called only from the collector thread
+void updateSystemInfo(SystemInfo& info);
+void updateCPUData(CPUData& cpu);
+void updateFanData(FanData& fan);
+void updateThermalData(ThermalData& thermal);
+void sampleMemory(MemorySnapshot& snapshot);
+void sampleProcesses(ProcessSnapshot& snapshot, const MemInfo& meminfo);
+void sampleNetwork(NetworkSnapshot& snapshot);
+
+// Rate of TASK_CPU, TASK_FAN or TASK_THERMAL as set by the FPS sliders
+float systemSampleRate(SampleTask task);
+
+// Owns all /proc and /sys sampling on a dedicated thread so a slow read
+// never stalls the frame loop. Each SampleTask has its own deadline in a
+// min-heap on CLOCK_MONOTONIC; a snapshot is published after every batch
+// of tasks that ran. The UI calls acquire() once per frame and the window
+// functions read current().
+class Collector {
+private:
+    MonitorSnapshot working;
+    SnapshotBuffer<MonitorSnapshot> snapshots;
+    // The triple buffer has a single reader, so the exporter thread gets its own
+    SnapshotBuffer<MonitorSnapshot> export_snapshots;
+    std::atomic<bool> export_enabled{false};
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    bool rates_pending = false;     // a slider moved since the scheduler read the rates
+    std::atomic<uint32_t> snapshot_event{0};
+    std::atomic<bool> snapshot_event_pending{false};
+
+    void run();
+    void runReplay();
+    void runTask(SampleTask task);
+    void publish();
+    void notifyPublished();
+
+public:
+    void start();
+    void stop();
+    // Wakes the scheduler so a slider change applies immediately
+    void ratesChanged();
+    // SDL event type pushed after a publish the UI has not seen yet
+    void setSnapshotEvent(uint32_t type) { snapshot_event = type; }
+    void snapshotEventHandled() { snapshot_event_pending = false; }
+    bool acquire() { return snapshots.acquire(); }
+    const MonitorSnapshot& current() const { return snapshots.front(); }
+    // Second reader channel, only filled once enabled; the metrics exporter owns it
+    void enableExport() { export_enabled = true; }
+    bool acquireExport() { return export_snapshots.acquire(); }
+    const MonitorSnapshot& currentExport() const { return export_snapshots.front(); }
+};
+
+extern Collector g_collector;
+
+// Append-only text buffer whose storage is kept between uses, so building
+// the same output again allocates nothing once it has grown to fit
+class TextBuffer {
+private:
+    std::vector<char> storage;
+    size_t length = 0;
+
+public:
+    explicit TextBuffer(size_t capacity) : storage(capacity) {}
+
+    void clear() { length = 0; }
+    const char* data() const { return storage.data(); }
+    size_t size() const { return length; }
+
+    void append(const char* text, size_t count) {
+        reserve(count);
+        memcpy(storage.data() + length, text, count);
+        length += count;
+    }
+    void append(const char* text) { append(text, strlen(text)); }
+
+    void appendf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        while (true) {
+            va_list args;
+            va_start(args, format);
+            size_t room = storage.size() - length;
+            int written = vsnprintf(storage.data() + length, room, format, args);
+            va_end(args);
+            if (written < 0) return;
+            if ((size_t)written < room) {
+                length += written;
+                return;
+            }
+            reserve(written + 1);
+        }
+    }
+
+private:
+    // Only grows when the output is longer than any before it
+    void reserve(size_t count) {
+        if (length + count > storage.size()) {
+            storage.resize(std::max(storage.size() * 2, length + count));
+        }
+    }
+};
+
+// monitor --headless: the collectors without SDL or OpenGL, streaming
+// snapshots to one or more sinks
+struct HeadlessOptions {
+    int interval_ms = 1000;
+    std::vector<std::string> outputs;       // "ndjson", "file:PATH" or "binary:PATH"
+    size_t rotate_bytes = 64 << 20;         // file: sinks rotate past this size
+    int rotate_keep = 5;                    // rotated files kept (PATH.1 ... PATH.N)
+};
+
+int runHeadless(const HeadlessOptions& options);
+
+// Serves the latest snapshot as OpenMetrics text over HTTP, on a TCP port
+// ("9100" binds 127.0.0.1, "HOST:PORT") or a Unix socket ("unix:PATH").
+// One thread accepts and answers scrapes in turn; each scrape renders from
+// the collector's export channel into a buffer kept between scrapes.
+class MetricsExporter {
+public:
+    ~MetricsExporter();
+
+    bool open(const std::string& address, int top_processes = 10);
+    void close();
+    const std::string& address() const { return listen_address; }
+
+private:
+    std::string listen_address;
+    std::string unix_path;          // removed again on close()
+    int listen_fd = -1;
+    int top_count = 10;
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    TextBuffer body{64 * 1024};
+    std::vector<char> request;
+    std::vector<const ProcessInfo*> top;
+    uint64_t scrapes = 0;
+
+    void run();
+    void serve(int client);
+    void render(const MonitorSnapshot& snapshot);
+};
+
+extern MetricsExporter g_exporter;
+
+// What the monitor itself spends time on. The collector scopes follow
+// SampleTask, so Collector::runTask can time a task by its index.
+enum ProfileScope {
+    SCOPE_SYSTEM_INFO,
+    SCOPE_CPU,
+    SCOPE_FAN,
+    SCOPE_THERMAL,
+    SCOPE_MEMINFO,
+    SCOPE_STATVFS,
+    SCOPE_PROCESS_SCAN,
+    SCOPE_NETWORK,
+    SCOPE_SYSTEM_WINDOW,
+    SCOPE_MEMORY_WINDOW,
+    SCOPE_NETWORK_WINDOW,
+    SCOPE_OVERHEAD_WINDOW,
+    SCOPE_FRAME,                // NewFrame through RenderDrawData, without the swap
+    SCOPE_COUNT
+};
+
+static_assert((int)SCOPE_NETWORK == (int)TASK_NETWORK, "collector scopes follow SampleTask");
+
+const char* describeProfileScope(ProfileScope scope);
+
+// Log-linear latency histogram in ns: 16 linear buckets per power of two,
+// so a percentile is within 1/16 of its true value, up to ~137 s. Each
+// histogram has one writing thread; any thread may read it.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKET_COUNT = SUB_BUCKETS * 34;
+
+    void record(uint64_t ns);
+    void reset();
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+    uint64_t percentile(double fraction) const;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maximum{0};
+};
+
+// Per-scope histograms plus the process's own CPU and memory use
+class Profiler {
+public:
+    void record(ProfileScope scope, uint64_t ns) { histograms[scope].record(ns); }
+    const LatencyHistogram& histogram(ProfileScope scope) const { return histograms[scope]; }
+    void reset();
+
+    // Refreshes cpu_percent and rss_bytes at most once a second; UI thread
+    void sampleSelf();
+    float cpuPercent() const { return cpu_percent; }    // % of one core
+    size_t rssBytes() const { return rss_bytes; }
+
+private:
+    LatencyHistogram histograms[SCOPE_COUNT];
+    double last_sample = 0.0;       // CLOCK_MONOTONIC seconds
+    double last_cpu = 0.0;          // user + system seconds
+    float cpu_percent = 0.0f;
+    size_t rss_bytes = 0;
+};
+
+extern Profiler g_profiler;
+
+// Times its enclosing scope on the steady clock; finish() ends it early
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfileScope scope)
+        : scope(scope), started(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { finish(); }
+
+    void finish() {
+        if (done) return;
+        done = true;
+        g_profiler.record(scope, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count());
+    }
+
+private:
+    ProfileScope scope;
+    std::chrono::steady_clock::time_point started;
+    bool done = false;
+};
+
+void overheadWindow(const char* id, ImVec2 size, ImVec2 position);
+
 void systemWindow(const char* id, ImVec2 size, ImVec2 position);
 string readFileContent(const string& path);
-float calculateCPUUsage();
+// Parses the aggregate and every cpuN line of /proc/stat in one pass,
+// filling cpu's breakdowns; returns the aggregate busy percentage
+float calculateCPUUsage(CPUData& cpu);
 string CPUinfo();
 const char *getOsName();
 
@@ -180,13 +1473,28 @@ public:
     void render();
 };
 
+// Decides when the main loop draws. Between frames it blocks in
+// SDL_WaitEventTimeout until there is input or the collector has published
+// a snapshot, so an untouched window costs nothing between samples. Input
+// buys a few extra frames for ImGui to settle hover and layout state.
 class PerformanceManager {
 private:
     const float TARGET_FRAMERATE = 60.0f;
     const float FRAME_TIME = 1000.0f / TARGET_FRAMERATE;
+    const int FRAMES_AFTER_INPUT = 3;
+    const int IDLE_TIMEOUT_MS = 500;        // still redraw a blinking text cursor
     std::chrono::steady_clock::time_point last_frame;
+    uint32_t snapshot_event = 0;
+    int frames_pending = 1;
     
 public:
+    // Registers the SDL event the collector pushes when it publishes
+    void initialize();
+    // Next event; blocks when no frame is pending. False when there is none.
+    bool nextEvent(SDL_Event& event);
+    void noteEvent(const SDL_Event& event);
+    bool frameNeeded() const { return frames_pending > 0; }
+    void frameRendered();
     void limitFrameRate();
 };
 
@@ -0,0 +1,327 @@
+#include "header.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/*
+Headless mode runs the collector thread exactly as the UI does and, every
+interval, serializes the newest snapshot to each configured sink:
+
+    ndjson          one JSON object per line on stdout
+    file:PATH       the same lines appended to PATH, rotated by size
+    binary:PATH     fixed-width HeadlessRecord structs ("-" for stdout)
+
+Serialization goes into buffers that are sized once and reused, so a
+steady-state sample allocates nothing.
+*/
+
+// One fixed-width binary record per snapshot, native byte order
+struct HeadlessRecord {
+    char magic[4];              // "SMR1"
+    uint32_t size;              // sizeof(HeadlessRecord)
+    uint64_t sequence;
+    double time;                // CLOCK_REALTIME seconds
+    float cpu_usage;
+    float temperature;
+    int32_t fan_speed;
+    uint32_t processes_total;
+    uint32_t processes_running;
+    uint32_t processes_sleeping;
+    uint32_t processes_disk_sleep;
+    uint32_t processes_zombie;
+    uint32_t processes_stopped;
+    uint32_t processes_idle;
+    uint64_t ram_used, ram_total;
+    uint64_t swap_used, swap_total;
+    uint64_t disk_used, disk_total;
+    uint64_t rx_bytes, tx_bytes;        // summed over all interfaces
+    float rx_rate, tx_rate;             // bytes per second
+};
+
+static volatile sig_atomic_t g_stop_requested = 0;
+
+static void requestStop(int) {
+    g_stop_requested = 1;
+}
+
+// JSON string with quotes; comm can hold any byte but NUL and '/'
+static void appendJsonString(TextBuffer& out, const char* text) {
+    out.append("\"", 1);
+    for (const char* p = text; *p; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\') {
+            char escaped[2] = {'\\', (char)c};
+            out.append(escaped, 2);
+        } else if (c < 0x20) {
+            out.appendf("\\u%04x", c);
+        } else {
+            out.append((const char*)&c, 1);
+        }
+    }
+    out.append("\"", 1);
+}
+
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+static double realtimeNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void serializeJson(const MonitorSnapshot& snapshot, double time, TextBuffer& out) {
+    const SystemSnapshot& system = snapshot.system;
+    const MemorySnapshot& memory = snapshot.memory;
+    const SystemProcessStats& stats = snapshot.processes.stats;
+
+    out.clear();
+    out.appendf("{\"seq\":%llu,\"time\":%.3f,\"host\":", (unsigned long long)snapshot.sequence, time);
+    appendJsonString(out, system.info.hostname.c_str());
+    out.appendf(",\"cpu\":{\"usage\":%.2f,\"user\":%.2f,\"system\":%.2f,\"iowait\":%.2f,\"steal\":%.2f}",
+                system.cpu.current_usage, system.cpu.states[CPU_USER], system.cpu.states[CPU_SYSTEM],
+                system.cpu.states[CPU_IOWAIT], system.cpu.states[CPU_STEAL]);
+    out.appendf(",\"thermal\":{\"temp\":%.1f},\"fan\":{\"speed\":%d,\"level\":%d}",
+                system.thermal.current_temp, system.fan.speed, system.fan.level);
+    out.appendf(",\"memory\":{\"used\":%zu,\"total\":%zu,\"percent\":%.2f}",
+                memory.ram.used, memory.ram.total, memory.ram.usage_percent);
+    out.appendf(",\"swap\":{\"used\":%zu,\"total\":%zu,\"percent\":%.2f}",
+                memory.swap.used, memory.swap.total, memory.swap.usage_percent);
+    out.appendf(",\"disk\":{\"used\":%zu,\"total\":%zu,\"percent\":%.2f}",
+                memory.disk.used, memory.disk.total, memory.disk.usage_percent);
+    out.appendf(",\"states\":{\"total\":%d,\"running\":%d,\"sleeping\":%d,\"disk_sleep\":%d,"
+                "\"zombie\":%d,\"stopped\":%d,\"idle\":%d}",
+                stats.total, stats.running, stats.sleeping, stats.disk_sleep,
+                stats.zombie, stats.stopped, stats.idle);
+
+    out.append(",\"network\":[");
+    bool first = true;
+    for (const NetworkInterface& iface : snapshot.network.interfaces) {
+        out.append(first ? "{\"name\":" : ",{\"name\":");
+        first = false;
+        appendJsonString(out, iface.name.c_str());
+        out.appendf(",\"rx_bytes\":%" PRIu64 ",\"tx_bytes\":%" PRIu64
+                    ",\"rx_rate\":%.1f,\"tx_rate\":%.1f,\"rx_packets_rate\":%.1f,\"tx_packets_rate\":%.1f"
+                    ",\"rx_errors_rate\":%.2f,\"tx_errors_rate\":%.2f,\"rx_drops_rate\":%.2f,\"tx_drops_rate\":%.2f}",
+                    iface.rx.bytes, iface.tx.bytes, iface.rates.rx_bytes, iface.rates.tx_bytes,
+                    iface.rates.rx_packets, iface.rates.tx_packets, iface.rates.rx_errors,
+                    iface.rates.tx_errors, iface.rates.rx_drops, iface.rates.tx_drops);
+    }
+
+    out.append("],\"processes\":[");
+    first = true;
+    for (const ProcessInfo& proc : snapshot.processes.rows) {
+        out.appendf(first ? "{\"pid\":%d,\"name\":" : ",{\"pid\":%d,\"name\":", proc.pid);
+        first = false;
+        appendJsonString(out, proc.name);
+        out.appendf(",\"state\":\"%c\",\"cpu\":%.2f,\"mem\":%.2f,\"minflt_rate\":%.0f,\"majflt_rate\":%.0f}",
+                    proc.state, proc.metrics.cpu_usage, proc.metrics.mem_usage,
+                    proc.metrics.minflt_rate, proc.metrics.majflt_rate);
+    }
+    out.append("]}\n");
+}
+
+static void fillRecord(const MonitorSnapshot& snapshot, double time, HeadlessRecord& record) {
+    memset(&record, 0, sizeof(record));
+    memcpy(record.magic, "SMR1", 4);
+    record.size = sizeof(record);
+    record.sequence = snapshot.sequence;
+    record.time = time;
+    record.cpu_usage = snapshot.system.cpu.current_usage;
+    record.temperature = snapshot.system.thermal.current_temp;
+    record.fan_speed = snapshot.system.fan.speed;
+
+    const SystemProcessStats& stats = snapshot.processes.stats;
+    record.processes_total = stats.total;
+    record.processes_running = stats.running;
+    record.processes_sleeping = stats.sleeping;
+    record.processes_disk_sleep = stats.disk_sleep;
+    record.processes_zombie = stats.zombie;
+    record.processes_stopped = stats.stopped;
+    record.processes_idle = stats.idle;
+
+    const MemorySnapshot& memory = snapshot.memory;
+    record.ram_used = memory.ram.used;
+    record.ram_total = memory.ram.total;
+    record.swap_used = memory.swap.used;
+    record.swap_total = memory.swap.total;
+    record.disk_used = memory.disk.used;
+    record.disk_total = memory.disk.total;
+
+    for (const NetworkInterface& iface : snapshot.network.interfaces) {
+        record.rx_bytes += iface.rx.bytes;
+        record.tx_bytes += iface.tx.bytes;
+        record.rx_rate += iface.rates.rx_bytes;
+        record.tx_rate += iface.rates.tx_bytes;
+    }
+}
+
+// Where serialized snapshots go
+class SnapshotSink {
+public:
+    virtual ~SnapshotSink() {}
+    virtual bool write(const MonitorSnapshot& snapshot, double time) = 0;
+};
+
+class NdjsonSink : public SnapshotSink {
+private:
+    int fd;
+    TextBuffer buffer{256 * 1024};
+
+public:
+    explicit NdjsonSink(int fd) : fd(fd) {}
+
+    bool write(const MonitorSnapshot& snapshot, double time) override {
+        serializeJson(snapshot, time, buffer);
+        return writeAll(fd, buffer.data(), buffer.size());
+    }
+};
+
+// NDJSON appended to a file; past max_bytes it becomes PATH.1, the old
+// PATH.1 becomes PATH.2 and so on, keeping `keep` files
+class RotatingFileSink : public SnapshotSink {
+private:
+    std::string path;
+    size_t max_bytes;
+    int keep;
+    int fd = -1;
+    size_t written = 0;
+    TextBuffer buffer{256 * 1024};
+    std::vector<char> from_path, to_path;     // rename scratch, sized once
+
+    bool reopen() {
+        if (fd >= 0) ::close(fd);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror(path.c_str());
+            return false;
+        }
+        struct stat info;
+        written = fstat(fd, &info) == 0 ? info.st_size : 0;
+        return true;
+    }
+
+    void rotate() {
+        for (int i = keep; i >= 1; i--) {
+            if (i == 1) {
+                snprintf(from_path.data(), from_path.size(), "%s", path.c_str());
+            } else {
+                snprintf(from_path.data(), from_path.size(), "%s.%d", path.c_str(), i - 1);
+            }
+            snprintf(to_path.data(), to_path.size(), "%s.%d", path.c_str(), i);
+            rename(from_path.data(), to_path.data());
+        }
+        reopen();
+    }
+
+public:
+    RotatingFileSink(const std::string& path, size_t max_bytes, int keep)
+        : path(path), max_bytes(max_bytes), keep(std::max(keep, 1)),
+          from_path(path.size() + 16), to_path(path.size() + 16) {
+        reopen();
+    }
+    ~RotatingFileSink() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool write(const MonitorSnapshot& snapshot, double time) override {
+        if (fd < 0) return false;
+        serializeJson(snapshot, time, buffer);
+        if (written > 0 && written + buffer.size() > max_bytes) rotate();
+        if (fd < 0 || !writeAll(fd, buffer.data(), buffer.size())) return false;
+        written += buffer.size();
+        return true;
+    }
+};
+
+class BinarySink : public SnapshotSink {
+private:
+    int fd;
+    bool owns_fd;
+
+public:
+    explicit BinarySink(const std::string& path) {
+        owns_fd = path != "-";
+        fd = owns_fd ? ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644) : 1;
+        if (fd < 0) perror(path.c_str());
+    }
+    ~BinarySink() {
+        if (owns_fd && fd >= 0) ::close(fd);
+    }
+
+    bool write(const MonitorSnapshot& snapshot, double time) override {
+        if (fd < 0) return false;
+        HeadlessRecord record;
+        fillRecord(snapshot, time, record);
+        return writeAll(fd, (const char*)&record, sizeof(record));
+    }
+};
+
+int runHeadless(const HeadlessOptions& options) {
+    std::vector<std::unique_ptr<SnapshotSink>> sinks;
+    std::vector<std::string> outputs = options.outputs;
+    if (outputs.empty()) outputs.push_back("ndjson");
+
+    for (const std::string& output : outputs) {
+        if (output == "ndjson") {
+            sinks.emplace_back(new NdjsonSink(1));
+        } else if (output.compare(0, 5, "file:") == 0 && output.size() > 5) {
+            sinks.emplace_back(new RotatingFileSink(output.substr(5), options.rotate_bytes, options.rotate_keep));
+        } else if (output.compare(0, 7, "binary:") == 0 && output.size() > 7) {
+            sinks.emplace_back(new BinarySink(output.substr(7)));
+        } else {
+            fprintf(stderr, "headless: unknown output '%s' (ndjson, file:PATH, binary:PATH)\n", output.c_str());
+            return 1;
+        }
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);   // a closed stdout pipe ends the run via write() failing
+
+    g_collector.start();
+
+    typedef std::chrono::steady_clock clock;
+    std::chrono::milliseconds interval(std::max(options.interval_ms, 10));
+    clock::time_point next = clock::now() + interval;
+    uint64_t last_sequence = 0;
+    int status = 0;
+
+    while (!g_stop_requested) {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        if (g_stop_requested) break;
+
+        g_collector.acquire();
+        const MonitorSnapshot& snapshot = g_collector.current();
+        if (snapshot.sequence == last_sequence) continue;     // nothing new yet
+        last_sequence = snapshot.sequence;
+
+        double time = realtimeNow();
+        bool ok = true;
+        for (auto& sink : sinks) {
+            ok = sink->write(snapshot, time) && ok;
+        }
+        if (!ok) {
+            status = 1;
+            break;
+        }
+    }
+
+    g_collector.stop();
+    return status;
+}
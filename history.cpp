@@ -0,0 +1,221 @@
+#include "header.h"
+
+// Raw samples kept per metric; ten minutes at 1 Hz, five at 2 Hz
+static const size_t RAW_CAPACITY = 600;
+
+// Bucket width and retention of each rollup tier
+static const double TIER_WIDTH[MetricHistory::TIER_COUNT] = {10.0, 60.0, 3600.0};
+static const size_t TIER_CAPACITY[MetricHistory::TIER_COUNT] = {
+    360,    // 1 hour of 10 s buckets
+    1440,   // 24 hours of 1 min buckets
+    168,    // 7 days of 1 h buckets
+};
+
+// Longer than the UI or an exporter keeps reading a published snapshot
+static const double RELEASE_GRACE = 60.0;
+
+// The real CLOCK_MONOTONIC, even while a capture is replayed: the grace
+// period protects readers running in real time, and reading the clock here
+// must not consume or add a reading in the capture stream
+static double releaseClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static const char* SPAN_NAMES[SPAN_COUNT] = {"Live", "1 hour", "24 hours", "7 days"};
+
+HistoryStore g_history;
+
+MetricHistory::MetricHistory() : raw(RAW_CAPACITY) {
+    for (int i = 0; i < TIER_COUNT; i++) {
+        tiers[i].setCapacity(TIER_CAPACITY[i]);
+    }
+}
+
+void MetricHistory::push(double time, float value) {
+    raw.push(time, value);
+    accumulate(0, time, value, value, value, value, 1);
+}
+
+// Folds samples into the tier's open bucket. When they belong to a later
+// bucket, the open one is closed into the tier and cascades into the next.
+void MetricHistory::accumulate(int tier, double time, float min, float max,
+                               double sum, float last, uint32_t count) {
+    Bucket& bucket = pending[tier];
+    double start = std::floor(time / TIER_WIDTH[tier]) * TIER_WIDTH[tier];
+
+    if (bucket.count > 0 && start != bucket.start) {
+        RollupPoint point;
+        point.min = bucket.min;
+        point.max = bucket.max;
+        point.avg = (float)(bucket.sum / bucket.count);
+        point.last = bucket.last;
+        tiers[tier].push(bucket.start, point);
+
+        if (tier + 1 < TIER_COUNT) {
+            accumulate(tier + 1, bucket.start, bucket.min, bucket.max, bucket.sum, bucket.last, bucket.count);
+        }
+        bucket.count = 0;
+    }
+
+    if (bucket.count == 0) {
+        bucket.start = start;
+        bucket.min = min;
+        bucket.max = max;
+        bucket.sum = sum;
+    } else {
+        bucket.min = std::min(bucket.min, min);
+        bucket.max = std::max(bucket.max, max);
+        bucket.sum += sum;
+    }
+    bucket.last = last;
+    bucket.count += count;
+}
+
+// Looks up, revives or creates the named metric; the caller holds the mutex
+MetricHistory* HistoryStore::obtain(const std::string& name) {
+    auto found = metrics.find(name);
+    if (found != metrics.end()) return &found->second;
+
+    for (size_t i = 0; i < retired.size(); i++) {
+        if (retired[i].node.key() == name) {
+            auto revived = metrics.insert(std::move(retired[i].node)).position;
+            retired.erase(retired.begin() + i);
+            names[revived->second.id] = &revived->first;
+            return &revived->second;
+        }
+    }
+
+    auto inserted = metrics.emplace(std::piecewise_construct,
+                                    std::forward_as_tuple(name), std::forward_as_tuple()).first;
+    inserted->second.id = next_id++;
+    names[inserted->second.id] = &inserted->first;
+    return &inserted->second;
+}
+
+MetricHistory* HistoryStore::metric(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    MetricHistory* history = obtain(name);
+    unclaimed.erase(history->id);
+    return history;
+}
+
+MetricHistory* HistoryStore::restoredMetric(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t first_new = next_id;
+    MetricHistory* history = obtain(name);
+    if (history->id >= first_new) unclaimed.insert(history->id);
+    return history;
+}
+
+MetricHistory* HistoryStore::find(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = metrics.find(name);
+    return found != metrics.end() ? &found->second : nullptr;
+}
+
+bool HistoryStore::metricName(uint32_t id, std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = names.find(id);
+    if (found == names.end()) return false;
+    name = *found->second;
+    return true;
+}
+
+void HistoryStore::release(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    double now = releaseClock();
+    freeRetired(now);
+
+    auto found = metrics.find(name);
+    if (found != metrics.end()) detach(found, now);
+}
+
+void HistoryStore::releaseUnclaimed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    double now = releaseClock();
+    std::unordered_set<uint32_t> unwanted;
+    unwanted.swap(unclaimed);
+    for (uint32_t id : unwanted) {
+        auto name = names.find(id);
+        if (name == names.end()) continue;
+        auto found = metrics.find(*name->second);
+        if (found != metrics.end()) detach(found, now);
+    }
+}
+
+void HistoryStore::detach(MetricMap::iterator found, double now) {
+    names.erase(found->second.id);
+    unclaimed.erase(found->second.id);
+    retired.push_back(Retired{now, metrics.extract(found)});
+}
+
+// Extracted nodes keep their address, so pointers handed out before the
+// release stay valid until the node is destroyed here
+void HistoryStore::freeRetired(double now) {
+    retired.erase(std::remove_if(retired.begin(), retired.end(),
+                      [now](const Retired& entry) { return now - entry.released_at > RELEASE_GRACE; }),
+                  retired.end());
+}
+
+void HistoryStore::record(MetricHistory* metric, double time, float value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    metric->push(time, value);
+
+    MetricJournal* sink = journal.load(std::memory_order_acquire);
+    if (sink) sink->append(metric->id, time, value);
+}
+
+void HistoryStore::restore(MetricHistory* metric, double time, float value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    metric->push(time, value);
+}
+
+static float rollupAverage(void* data, int index) {
+    return (*(const TimeSeries<RollupPoint>*)data)[index].avg;
+}
+
+HistoryView plotHistory(const char* label, const MetricHistory* metric, HistorySpan span,
+                        const char* overlay, float scale_max, ImVec2 size,
+                        float auto_floor) {
+    HistoryView view{};
+    std::lock_guard<std::mutex> lock(g_history.mutex);
+
+    if (span == SPAN_LIVE || !metric) {
+        static const TimeSeries<float> empty(1);
+        const TimeSeries<float>& series = metric ? metric->rawSamples() : empty;
+        view.count = series.size();
+        for (int i = 0; i < view.count; i++) {
+            if (series[i] > view.peak || i == 0) {
+                view.peak = series[i];
+                view.peak_index = i;
+            }
+        }
+        if (view.count > 0) view.latest = series.latest();
+        view.scale_max = scale_max > 0.0f ? scale_max : std::max(view.peak * 1.1f, auto_floor);
+        ImGui::PlotLines(label, series.values(), series.size(), series.offset(),
+                         overlay, 0.0f, view.scale_max, size);
+    } else {
+        const TimeSeries<RollupPoint>& series = metric->tier(span - 1);
+        view.count = series.size();
+        for (int i = 0; i < view.count; i++) {
+            if (series[i].max > view.peak || i == 0) {
+                view.peak = series[i].max;
+                view.peak_index = i;
+            }
+        }
+        if (view.count > 0) view.latest = series.latest().last;
+        view.scale_max = scale_max > 0.0f ? scale_max : std::max(view.peak * 1.1f, auto_floor);
+        ImGui::PlotLines(label, rollupAverage, (void*)&series, series.size(), 0,
+                         overlay, 0.0f, view.scale_max, size);
+    }
+    return view;
+}
+
+void renderSpanSelector(const char* label, HistorySpan& span) {
+    int selected = span;
+    if (ImGui::Combo(label, &selected, SPAN_NAMES, SPAN_COUNT)) {
+        span = (HistorySpan)selected;
+    }
+}
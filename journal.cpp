@@ -0,0 +1,440 @@
+#include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+Segment file layout, native byte order:
+
+    offset 0        JournalHeader                       64 bytes
+    offset 64       JournalSchemaEntry[SCHEMA_CAPACITY] 64 bytes each
+    offset 16384    JournalRecord[SEGMENT_RECORDS]      24 bytes each
+
+Files are named segment-<sequence as 16 hex digits>.smj and are created at
+full size, so unwritten records read back as zeros. Every header, schema
+entry and record carries an FNV-1a checksum of the bytes before it; a
+reader stops at the first record whose checksum does not match, which is
+where the writer was when the process or the host went down.
+
+Metric ids are local to a segment: its schema names only the metrics that
+appear in it, so ids are reused from one segment to the next. A segment is
+rotated when its records or its schema run out. A new run resumes the newest
+segment at its first invalid record if every record before it is named by
+the schema, and starts a new segment otherwise. A segment ends where the
+next one was created; once that is older than REPLAY_WINDOW it is deleted.
+*/
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;       // offset of the first record
+    uint32_t record_size;
+    uint32_t schema_capacity;
+    uint64_t sequence;
+    uint64_t record_capacity;
+    double created;             // CLOCK_REALTIME seconds
+    uint32_t reserved[3];
+    uint32_t checksum;
+};
+
+// Maps the metric ids used by this segment's records to metric names
+struct JournalSchemaEntry {
+    char name[56];
+    uint32_t id;
+    uint32_t checksum;
+};
+
+struct JournalRecord {
+    double time;                // CLOCK_REALTIME seconds
+    uint32_t metric;
+    float value;
+    uint32_t reserved;
+    uint32_t checksum;
+};
+
+static const char JOURNAL_MAGIC[8] = {'S', 'M', 'J', 'R', 'N', 'L', 0, 1};
+static const uint32_t JOURNAL_VERSION = 1;
+static const uint32_t SCHEMA_CAPACITY = 255;
+static const size_t HEADER_SIZE = 16384;
+static const size_t SEGMENT_RECORDS = 1 << 20;      // 24 MB, about 8 h with two interfaces
+
+// Older samples are past even the 1 h tier and are not worth replaying
+static const double REPLAY_WINDOW = 7 * 24 * 3600.0;
+
+static_assert(sizeof(JournalHeader) == 64, "journal header layout");
+static_assert(sizeof(JournalSchemaEntry) == 64, "journal schema layout");
+static_assert(sizeof(JournalRecord) == 24, "journal record layout");
+static_assert(sizeof(JournalHeader) + SCHEMA_CAPACITY * sizeof(JournalSchemaEntry) <= HEADER_SIZE,
+              "journal schema must fit in the header");
+
+MetricJournal g_journal;
+
+static uint32_t fnv1a(const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Checksum of everything before the trailing checksum field
+template <typename T>
+static uint32_t checksumOf(const T& value) {
+    return fnv1a(&value, offsetof(T, checksum));
+}
+
+static double realtimeSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Segment sequence numbers found in directory, oldest first
+static std::vector<uint64_t> listSegments(const std::string& directory) {
+    std::vector<uint64_t> sequences;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return sequences;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        unsigned long long sequence;
+        char suffix[8];
+        if (sscanf(entry->d_name, "segment-%16llx.%7s", &sequence, suffix) == 2 &&
+            strcmp(suffix, "smj") == 0) {
+            sequences.push_back(sequence);
+        }
+    }
+    closedir(dir);
+    std::sort(sequences.begin(), sequences.end());
+    return sequences;
+}
+
+static bool validHeader(const JournalHeader& header) {
+    return memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+           header.checksum == checksumOf(header) &&
+           header.version == JOURNAL_VERSION &&
+           header.header_size == HEADER_SIZE &&
+           header.record_size == sizeof(JournalRecord) &&
+           header.schema_capacity <= SCHEMA_CAPACITY;
+}
+
+// CLOCK_REALTIME creation time from a segment's header
+static bool segmentCreated(const std::string& path, double& created) {
+    int segment = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (segment < 0) return false;
+    JournalHeader header;
+    bool valid = pread(segment, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 validHeader(header);
+    ::close(segment);
+    if (valid) created = header.created;
+    return valid;
+}
+
+static std::string segmentPath(const std::string& directory, uint64_t sequence) {
+    char name[64];
+    snprintf(name, sizeof(name), "/segment-%016llx.smj", (unsigned long long)sequence);
+    return directory + name;
+}
+
+MetricJournal::~MetricJournal() {
+    close();
+}
+
+bool MetricJournal::open(const std::string& path) {
+    if (running) return true;
+    directory = path;
+    if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST) {
+        perror(directory.c_str());
+        return false;
+    }
+
+    wall_offset = realtimeSeconds() - monotonicSeconds();
+    replay();
+    if (!resumeSegment() && !startSegment()) return false;
+    removeOldSegments();
+
+    running = true;
+    writer = std::thread(&MetricJournal::run, this);
+    g_history.attachJournal(this);
+    return true;
+}
+
+void MetricJournal::close() {
+    g_history.attachJournal(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+void MetricJournal::append(uint32_t metric, double time, float value) {
+    if (!queue.push(Pending{time, metric, value})) dropped++;
+}
+
+// Loads every intact record of the existing segments straight into the
+// history store. Records are fixed-size binary, so this is a linear walk
+// over mapped memory.
+void MetricJournal::replay() {
+    double oldest = realtimeSeconds() - REPLAY_WINDOW;
+
+    for (uint64_t sequence : listSegments(directory)) {
+        segment_sequence = std::max(segment_sequence, sequence);
+
+        int segment = ::open(segmentPath(directory, sequence).c_str(), O_RDONLY | O_CLOEXEC);
+        if (segment < 0) continue;
+        struct stat info;
+        if (fstat(segment, &info) < 0 || (size_t)info.st_size < HEADER_SIZE) {
+            ::close(segment);
+            continue;
+        }
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, segment, 0);
+        ::close(segment);
+        if (data == MAP_FAILED) continue;
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+        const JournalHeader* header = (const JournalHeader*)data;
+        bool valid = validHeader(*header);
+
+        // Segment-local metric ids to schema entries, and to metrics in the
+        // store once a record in the window restores into them; metrics
+        // whose records are all too old are never created
+        std::vector<const JournalSchemaEntry*> entries;
+        std::vector<MetricHistory*> metrics;
+        if (valid) {
+            entries.assign(header->schema_capacity, nullptr);
+            metrics.assign(header->schema_capacity, nullptr);
+            const JournalSchemaEntry* schema = (const JournalSchemaEntry*)(header + 1);
+            for (uint32_t i = 0; i < header->schema_capacity; i++) {
+                const JournalSchemaEntry& entry = schema[i];
+                if (entry.checksum != checksumOf(entry) || entry.id >= entries.size()) continue;
+                entries[entry.id] = &entry;
+            }
+        }
+
+        size_t capacity = valid ? std::min<size_t>(header->record_capacity,
+                                                   (info.st_size - HEADER_SIZE) / sizeof(JournalRecord)) : 0;
+        const JournalRecord* records = (const JournalRecord*)((const char*)data + HEADER_SIZE);
+        for (size_t i = 0; i < capacity; i++) {
+            const JournalRecord& record = records[i];
+            if (record.checksum != checksumOf(record)) break;
+            if (record.time < oldest || record.metric >= entries.size() || !entries[record.metric]) continue;
+            if (!metrics[record.metric]) {
+                const JournalSchemaEntry& entry = *entries[record.metric];
+                std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+                metrics[record.metric] = g_history.restoredMetric(name);
+            }
+            g_history.restore(metrics[record.metric], record.time - wall_offset, record.value);
+            restored++;
+        }
+        munmap(data, info.st_size);
+    }
+}
+
+// Reopens the newest segment for appending after its last intact record
+bool MetricJournal::resumeSegment() {
+    std::vector<uint64_t> sequences = listSegments(directory);
+    if (sequences.empty()) return false;
+    size_t size = HEADER_SIZE + SEGMENT_RECORDS * sizeof(JournalRecord);
+
+    int segment = ::open(segmentPath(directory, sequences.back()).c_str(), O_RDWR | O_CLOEXEC);
+    if (segment < 0) return false;
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(segment, &info) == 0 && (size_t)info.st_size == size) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+    }
+    if (data == MAP_FAILED) {
+        ::close(segment);
+        return false;
+    }
+
+    const JournalHeader* header = (const JournalHeader*)data;
+    bool valid = validHeader(*header) &&
+                 header->schema_capacity == SCHEMA_CAPACITY &&
+                 header->record_capacity == SEGMENT_RECORDS;
+
+    // The schema is written in id order, so the intact entries are a prefix
+    std::unordered_map<uint32_t, uint32_t> ids;
+    uint32_t named = 0;
+    const JournalSchemaEntry* schema = (const JournalSchemaEntry*)(header + 1);
+    for (; valid && named < SCHEMA_CAPACITY; named++) {
+        const JournalSchemaEntry& entry = schema[named];
+        if (entry.checksum != checksumOf(entry) || entry.id != named) break;
+        // Names with nothing in the replay window have no metric; they keep
+        // their id here, and come back under a new one if they reappear
+        std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        MetricHistory* restored_metric = g_history.find(name);
+        if (restored_metric) ids[restored_metric->id] = named;
+    }
+
+    // A record whose schema entry was lost would be renamed by the next one
+    size_t tail = 0;
+    const JournalRecord* records = (const JournalRecord*)((const char*)data + HEADER_SIZE);
+    for (; valid && tail < SEGMENT_RECORDS; tail++) {
+        if (records[tail].checksum != checksumOf(records[tail])) break;
+        if (records[tail].metric >= named) valid = false;
+    }
+
+    if (!valid || tail == SEGMENT_RECORDS) {
+        munmap(data, size);
+        ::close(segment);
+        return false;
+    }
+    fd = segment;
+    mapping = (char*)data;
+    segment_sequence = sequences.back();
+    next_record = tail;
+    segment_ids.swap(ids);
+    schema_written = named;
+    return true;
+}
+
+bool MetricJournal::startSegment() {
+    segment_sequence++;
+    std::string path = segmentPath(directory, segment_sequence);
+    size_t size = HEADER_SIZE + SEGMENT_RECORDS * sizeof(JournalRecord);
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (data == MAP_FAILED) {
+        perror(path.c_str());
+        ::close(fd);
+        fd = -1;
+        unlink(path.c_str());
+        return false;
+    }
+    mapping = (char*)data;
+    next_record = 0;
+    segment_ids.clear();
+    schema_written = 0;
+
+    JournalHeader header = {};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.header_size = HEADER_SIZE;
+    header.record_size = sizeof(JournalRecord);
+    header.schema_capacity = SCHEMA_CAPACITY;
+    header.sequence = segment_sequence;
+    header.record_capacity = SEGMENT_RECORDS;
+    header.created = realtimeSeconds();
+    header.checksum = checksumOf(header);
+    memcpy(mapping, &header, sizeof(header));
+    return true;
+}
+
+void MetricJournal::finishSegment() {
+    if (!mapping) return;
+    size_t size = HEADER_SIZE + SEGMENT_RECORDS * sizeof(JournalRecord);
+    msync(mapping, size, MS_SYNC);
+    munmap(mapping, size);
+    ::close(fd);
+    mapping = nullptr;
+    fd = -1;
+}
+
+// Walks from the newest segment back, deleting each one whose successor was
+// created before the replay window; the newest segment is always kept
+void MetricJournal::removeOldSegments() {
+    std::vector<uint64_t> sequences = listSegments(directory);
+    double oldest = realtimeSeconds() - REPLAY_WINDOW;
+    double ended = HUGE_VAL;
+    for (size_t i = sequences.size(); i-- > 0;) {
+        std::string path = segmentPath(directory, sequences[i]);
+        if (ended < oldest) {
+            unlink(path.c_str());
+            continue;
+        }
+        double created;
+        if (segmentCreated(path, created)) ended = std::min(ended, created);
+    }
+}
+
+// Segment-local id of a store metric, naming it in the header on first use.
+// Fails for a metric that was released before its samples were written.
+bool MetricJournal::segmentId(uint32_t metric, uint32_t& id) {
+    auto found = segment_ids.find(metric);
+    if (found != segment_ids.end()) {
+        id = found->second;
+        return true;
+    }
+    std::string name;
+    if (!g_history.metricName(metric, name)) return false;
+
+    JournalSchemaEntry entry = {};
+    strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+    entry.id = schema_written;
+    entry.checksum = checksumOf(entry);
+    JournalSchemaEntry* schema = (JournalSchemaEntry*)(mapping + sizeof(JournalHeader));
+    schema[schema_written] = entry;
+    segment_ids[metric] = schema_written;
+    id = schema_written++;
+    return true;
+}
+
+void MetricJournal::drain() {
+    Pending sample;
+    size_t first = next_record;
+    while (mapping && queue.pop(sample)) {
+        bool schema_full = schema_written == SCHEMA_CAPACITY && !segment_ids.count(sample.metric);
+        if (next_record == SEGMENT_RECORDS || schema_full) {
+            finishSegment();
+            if (!startSegment()) break;
+            removeOldSegments();
+            first = 0;
+        }
+        uint32_t id;
+        if (!segmentId(sample.metric, id)) {
+            dropped++;
+            continue;
+        }
+
+        JournalRecord record = {};
+        record.time = sample.time + wall_offset;
+        record.metric = id;
+        record.value = sample.value;
+        record.checksum = checksumOf(record);
+        JournalRecord* records = (JournalRecord*)(mapping + HEADER_SIZE);
+        records[next_record++] = record;
+    }
+
+    if (dropped > 0 && !drop_reported) {
+        drop_reported = true;
+        fprintf(stderr, "Journal: dropped %zu samples, either the writer fell behind or their "
+                        "metric was already released; further drops are only counted\n", dropped.load());
+    }
+
+    // Start writeback of what was appended; durability beyond the page
+    // cache is bounded by the kernel's dirty writeback interval
+    if (mapping && next_record > first) {
+        long page = sysconf(_SC_PAGE_SIZE);
+        size_t begin = (HEADER_SIZE + first * sizeof(JournalRecord)) & ~(size_t)(page - 1);
+        size_t end = HEADER_SIZE + next_record * sizeof(JournalRecord);
+        msync(mapping + begin, end - begin, MS_ASYNC);
+    }
+}
+
+void MetricJournal::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        wake.wait_for(lock, std::chrono::seconds(1), [this] { return !running; });
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+    lock.unlock();
+    drain();
+    finishSegment();
+}
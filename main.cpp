@@ -23,9 +23,150 @@ NOTE : You are free to change the code as you wish, the main objective is to mak
             This function will draw the network window on your screen
 */
 
+void PerformanceManager::initialize()
+{
+    snapshot_event = SDL_RegisterEvents(1);
+    if (snapshot_event == (uint32_t)-1)
+        snapshot_event = 0;     // no wakeups; the idle timeout still redraws
+    g_collector.setSnapshotEvent(snapshot_event);
+    last_frame = std::chrono::steady_clock::now();
+}
+
+bool PerformanceManager::nextEvent(SDL_Event &event)
+{
+    if (frames_pending > 0)
+        return SDL_PollEvent(&event) != 0;
+    if (SDL_WaitEventTimeout(&event, IDLE_TIMEOUT_MS))
+        return true;
+    // Timed out: only a focused text field has anything to animate
+    if (ImGui::GetIO().WantTextInput)
+        frames_pending = 1;
+    return false;
+}
+
+void PerformanceManager::noteEvent(const SDL_Event &event)
+{
+    if (snapshot_event != 0 && event.type == snapshot_event)
+    {
+        g_collector.snapshotEventHandled();
+        frames_pending = std::max(frames_pending, 1);
+    }
+    else
+    {
+        frames_pending = std::max(frames_pending, FRAMES_AFTER_INPUT);
+    }
+}
+
+void PerformanceManager::frameRendered()
+{
+    if (frames_pending > 0)
+        frames_pending--;
+}
+
+// Vsync normally paces frames already; this covers drivers that ignore it
+void PerformanceManager::limitFrameRate()
+{
+    auto frame_time = std::chrono::duration<float, std::milli>(FRAME_TIME);
+    auto next_frame = last_frame + std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_time);
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_frame)
+        std::this_thread::sleep_until(next_frame);
+    last_frame = std::max(now, next_frame);
+}
+
 // Main code
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    // Command line: --journal DIR keeps metric history on disk across restarts;
+    // --headless streams snapshots to the --output sinks instead of opening a window;
+    // --metrics ADDR serves them to Prometheus in either mode;
+    // --record FILE captures the raw kernel reads, --replay FILE plays them back;
+    // --root DIR reads /proc and /sys from a fixture tree (see fixturegen)
+    const char *journal_dir = nullptr;
+    const char *metrics_address = nullptr;
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    double replay_speed = 1.0;
+    bool headless = false;
+    HeadlessOptions headless_options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+            journal_dir = argv[++i];
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+            metrics_address = argv[++i];
+        else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc)
+            setKernelRoot(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+            replay_speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+            headless_options.interval_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            headless_options.outputs.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--rotate-size") == 0 && i + 1 < argc)
+            headless_options.rotate_bytes = (size_t)std::max(1, atoi(argv[++i])) << 20;
+        else if (strcmp(argv[i], "--rotate-keep") == 0 && i + 1 < argc)
+            headless_options.rotate_keep = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--journal DIR] [--metrics PORT|HOST:PORT|unix:PATH] [--root DIR]\n"
+                            "       [--record FILE | --replay FILE [--speed X]]\n"
+                            "       [--headless [--interval MS] [--output ndjson|file:PATH|binary:PATH]... [--rotate-size MB] [--rotate-keep N]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (record_path && replay_path)
+    {
+        fprintf(stderr, "--record and --replay cannot be combined\n");
+        return 1;
+    }
+
+    // Both have to be in place before the collector takes its first sample
+    if (record_path && !g_capture.openRecording(record_path))
+        return 1;
+    if (replay_path)
+    {
+        if (!g_capture.openReplay(replay_path, replay_speed))
+            return 1;
+        // Replayed samples carry the recording host's clock
+        if (journal_dir)
+            fprintf(stderr, "Journal: not kept while replaying a capture\n");
+        journal_dir = nullptr;
+    }
+
+    // Reload history before the first sample so graphs start where they left off.
+    // Headless output may be on stdout, so status goes to stderr there.
+    if (journal_dir)
+    {
+        if (g_journal.open(journal_dir))
+            fprintf(headless ? stderr : stdout, "Journal: restored %zu samples from %s\n", g_journal.restoredRecords(), journal_dir);
+        else
+            fprintf(stderr, "Journal: could not open %s, history will not be kept\n", journal_dir);
+    }
+
+    if (metrics_address)
+    {
+        if (g_exporter.open(metrics_address))
+            fprintf(stderr, "Metrics: serving OpenMetrics on %s\n", metrics_address);
+        else
+            return 1;
+    }
+
+    if (headless)
+    {
+        int status = runHeadless(headless_options);
+        g_exporter.close();
+        g_journal.close();
+        g_capture.close();
+        return status;
+    }
+
     // Setup SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
     {
@@ -74,6 +215,11 @@ int main(int, char **)
     // note : you are free to change the style of the application
     ImVec4 clear_color = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
 
+    // All /proc and /sys sampling happens on the collector thread
+    PerformanceManager frame_policy;
+    frame_policy.initialize();
+    g_collector.start();
+
     // Main loop
     bool done = false;
     while (!done)
@@ -83,34 +229,54 @@ int main(int, char **)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        // With no frame pending the first call blocks until input or a new snapshot arrives.
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        while (frame_policy.nextEvent(event))
         {
+            frame_policy.noteEvent(event);
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
                 done = true;
             if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
                 done = true;
         }
+        if (done || !frame_policy.frameNeeded())
+            continue;
 
         // Start the Dear ImGui frame
+        ScopedTimer frame_timer(SCOPE_FRAME);
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame(window);
         ImGui::NewFrame();
 
+        // Pick up the newest snapshot once per frame so every window draws the same one
+        g_collector.acquire();
+
         {
             ImVec2 mainDisplay = io.DisplaySize;
-            memoryProcessesWindow("== Memory and Processes ==",
-                                  ImVec2((mainDisplay.x / 2) - 20, (mainDisplay.y / 2) + 30),
-                                  ImVec2((mainDisplay.x / 2) + 10, 10));
+            {
+                ScopedTimer timer(SCOPE_MEMORY_WINDOW);
+                memoryProcessesWindow("== Memory and Processes ==",
+                                      ImVec2((mainDisplay.x / 2) - 20, (mainDisplay.y / 2) + 30),
+                                      ImVec2((mainDisplay.x / 2) + 10, 10));
+            }
             // --------------------------------------
-            systemWindow("== System ==",
-                         ImVec2((mainDisplay.x / 2) - 10, (mainDisplay.y / 2) + 30),
-                         ImVec2(10, 10));
+            {
+                ScopedTimer timer(SCOPE_SYSTEM_WINDOW);
+                systemWindow("== System ==",
+                             ImVec2((mainDisplay.x / 2) - 10, (mainDisplay.y / 2) + 30),
+                             ImVec2(10, 10));
+            }
+            // --------------------------------------
+            {
+                ScopedTimer timer(SCOPE_NETWORK_WINDOW);
+                networkWindow("== Network ==",
+                              ImVec2(mainDisplay.x - 20, (mainDisplay.y / 2) - 60),
+                              ImVec2(10, (mainDisplay.y / 2) + 50));
+            }
             // --------------------------------------
-            networkWindow("== Network ==",
-                          ImVec2(mainDisplay.x - 20, (mainDisplay.y / 2) - 60),
-                          ImVec2(10, (mainDisplay.y / 2) + 50));
+            overheadWindow("== Monitor Overhead ==", ImVec2(520, 380),
+                           ImVec2(mainDisplay.x - 530, mainDisplay.y - 30));
         }
 
         // Rendering
@@ -119,27 +285,26 @@ int main(int, char **)
         glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        frame_timer.finish();
         SDL_GL_SwapWindow(window);
+        frame_policy.frameRendered();
+        frame_policy.limitFrameRate();
     }
 
+    g_exporter.close();
+    g_collector.stop();
+    g_journal.close();
+    g_capture.close();
+
     // Print debug statistics before cleanup
     printf("\n=== SYSTEM MONITOR DEBUG STATISTICS ===\n");
 
     // Memory statistics
-    std::ifstream meminfo("/proc/meminfo");
-    std::string line;
-    size_t mem_total = 0, mem_available = 0, swap_total = 0, swap_free = 0;
-
-    while (std::getline(meminfo, line)) {
-        if (line.find("MemTotal:") == 0)
-            sscanf(line.c_str(), "MemTotal: %zu kB", &mem_total);
-        else if (line.find("MemAvailable:") == 0)
-            sscanf(line.c_str(), "MemAvailable: %zu kB", &mem_available);
-        else if (line.find("SwapTotal:") == 0)
-            sscanf(line.c_str(), "SwapTotal: %zu kB", &swap_total);
-        else if (line.find("SwapFree:") == 0)
-            sscanf(line.c_str(), "SwapFree: %zu kB", &swap_free);
-    }
+    MemInfo meminfo;
+    MemInfoReader meminfo_reader;
+    meminfo_reader.sample(meminfo);
+    size_t mem_total = meminfo.mem_total, mem_available = meminfo.mem_available;
+    size_t swap_total = meminfo.swap_total, swap_free = meminfo.swap_free;
 
     printf("Debug: mem_total=%zu, mem_available=%zu\n", mem_total, mem_available);
     if (mem_total > 0 && mem_available > 0) {
@@ -163,15 +328,12 @@ int main(int, char **)
 
     // Process count
     int process_count = 0;
-    DIR* proc_dir = opendir("/proc");
-    if (proc_dir) {
-        struct dirent* entry;
-        while ((entry = readdir(proc_dir)) != nullptr) {
-            if (isdigit(entry->d_name[0])) {
-                process_count++;
-            }
+    KernelDirectory proc_dir("/proc");
+    const char* name;
+    while ((name = proc_dir.next()) != nullptr) {
+        if (isdigit(name[0])) {
+            process_count++;
         }
-        closedir(proc_dir);
     }
     printf("Processes: %d total detected\n", process_count);
 
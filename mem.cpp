@@ -1,6 +1,7 @@
 #include "header.h"
 #include <cstring>
 #include <cstdlib>
+#include <fcntl.h>
 
 // Utility function to format sizes in human readable format
 std::string formatSize(size_t bytes) {
@@ -19,116 +20,224 @@ std::string formatSize(size_t bytes) {
     return std::string(buffer);
 }
 
-// RAM Status implementation
-struct RAMStatus {
-    size_t total;
-    size_t used;
-    size_t free;
-    float usage_percent;
-
-    void update() {
-        std::ifstream meminfo("/proc/meminfo");
-        std::string line;
-        size_t available = 0;
-        total = 0;
-
-        while (std::getline(meminfo, line)) {
-            if (line.find("MemTotal:") == 0)
-                sscanf(line.c_str(), "MemTotal: %zu kB", &total);
-            else if (line.find("MemAvailable:") == 0)
-                sscanf(line.c_str(), "MemAvailable: %zu kB", &available);
+// /proc/meminfo keys in the order the kernel prints them, so the parser can
+// usually match a line against the slot after the previous match
+struct MemInfoKey {
+    const char* name;
+    size_t length;
+    size_t MemInfo::*field;
+};
+
+#define MEMINFO_KEY(name, field) { name, sizeof(name) - 1, &MemInfo::field }
+static const MemInfoKey MEMINFO_KEYS[] = {
+    MEMINFO_KEY("MemTotal", mem_total),
+    MEMINFO_KEY("MemFree", mem_free),
+    MEMINFO_KEY("MemAvailable", mem_available),
+    MEMINFO_KEY("Buffers", buffers),
+    MEMINFO_KEY("Cached", cached),
+    MEMINFO_KEY("SwapCached", swap_cached),
+    MEMINFO_KEY("Active", active),
+    MEMINFO_KEY("Inactive", inactive),
+    MEMINFO_KEY("Active(anon)", active_anon),
+    MEMINFO_KEY("Inactive(anon)", inactive_anon),
+    MEMINFO_KEY("Active(file)", active_file),
+    MEMINFO_KEY("Inactive(file)", inactive_file),
+    MEMINFO_KEY("Unevictable", unevictable),
+    MEMINFO_KEY("Mlocked", mlocked),
+    MEMINFO_KEY("SwapTotal", swap_total),
+    MEMINFO_KEY("SwapFree", swap_free),
+    MEMINFO_KEY("Dirty", dirty),
+    MEMINFO_KEY("Writeback", writeback),
+    MEMINFO_KEY("AnonPages", anon_pages),
+    MEMINFO_KEY("Mapped", mapped),
+    MEMINFO_KEY("Shmem", shmem),
+    MEMINFO_KEY("KReclaimable", kreclaimable),
+    MEMINFO_KEY("Slab", slab),
+    MEMINFO_KEY("SReclaimable", sreclaimable),
+    MEMINFO_KEY("SUnreclaim", sunreclaim),
+    MEMINFO_KEY("KernelStack", kernel_stack),
+    MEMINFO_KEY("PageTables", page_tables),
+    MEMINFO_KEY("CommitLimit", commit_limit),
+    MEMINFO_KEY("Committed_AS", committed_as),
+    MEMINFO_KEY("VmallocUsed", vmalloc_used),
+    MEMINFO_KEY("AnonHugePages", anon_huge_pages),
+    MEMINFO_KEY("HugePages_Total", hugepages_total),
+    MEMINFO_KEY("HugePages_Free", hugepages_free),
+    MEMINFO_KEY("HugePages_Rsvd", hugepages_rsvd),
+    MEMINFO_KEY("HugePages_Surp", hugepages_surp),
+    MEMINFO_KEY("Hugepagesize", hugepagesize),
+    MEMINFO_KEY("Hugetlb", hugetlb),
+};
+#undef MEMINFO_KEY
+static const size_t MEMINFO_KEY_COUNT = sizeof(MEMINFO_KEYS) / sizeof(MEMINFO_KEYS[0]);
+
+static const MemInfoKey* findMemInfoKey(const char* name, size_t length, size_t& hint) {
+    for (size_t i = 0; i < MEMINFO_KEY_COUNT; i++) {
+        size_t slot = (hint + i) % MEMINFO_KEY_COUNT;
+        const MemInfoKey& key = MEMINFO_KEYS[slot];
+        if (key.length == length && memcmp(key.name, name, length) == 0) {
+            hint = (slot + 1) % MEMINFO_KEY_COUNT;
+            return &key;
         }
+    }
+    return nullptr;
+}
 
-        if (total > 0 && available > 0) {
-            total *= 1024; // Convert from KB to bytes
-            available *= 1024;
-            used = total - available;
-            free = available;
-            usage_percent = ((float)used / total) * 100.0f;
-        } else {
-            // Fallback if MemAvailable not found
-            total = used = free = 0;
-            usage_percent = 0.0f;
+bool MemInfoReader::sample(MemInfo& info) {
+    size_t length = 0;
+    const char* buffer = file.read(&length);
+    if (!buffer || length == 0) return false;
+
+    info = MemInfo();
+    next_key = 0;
+
+    // Each line is "Key:<spaces>value[ kB]\n"
+    const char* p = buffer;
+    const char* end = buffer + length;
+    while (p < end) {
+        const char* colon = (const char*)memchr(p, ':', end - p);
+        if (!colon) break;
+
+        const MemInfoKey* key = findMemInfoKey(p, colon - p, next_key);
+        p = colon + 1;
+        while (p < end && *p == ' ') p++;
+
+        size_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p - '0');
+            p++;
         }
+        if (key) info.*(key->field) = value;
+
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        p = newline ? newline + 1 : end;
     }
+    return info.mem_total > 0;
+}
 
-    void render() {
-        ImGui::Text("RAM Usage: %s / %s", 
-            formatSize(used).c_str(), 
-            formatSize(total).c_str());
-        ImGui::ProgressBar(usage_percent / 100.0f);
+// RAM Status implementation
+void RAMStatus::update(const MemInfo& info) {
+    if (info.mem_total > 0 && info.mem_available > 0) {
+        total = info.mem_total * 1024; // Convert from KB to bytes
+        free = info.mem_available * 1024;
+        used = total - free;
+        usage_percent = ((float)used / total) * 100.0f;
+    } else {
+        // Fallback if MemAvailable not found
+        total = used = free = 0;
+        usage_percent = 0.0f;
     }
-};
+}
 
-// SWAP Status implementation
-struct SwapStatus {
-    size_t total;
-    size_t used;
-    size_t free;
-    float usage_percent;
-
-    void update() {
-        std::ifstream meminfo("/proc/meminfo");
-        std::string line;
-        total = 0;
-        free = 0;
-
-        while (std::getline(meminfo, line)) {
-            if (line.find("SwapTotal:") == 0)
-                sscanf(line.c_str(), "SwapTotal: %zu kB", &total);
-            else if (line.find("SwapFree:") == 0)
-                sscanf(line.c_str(), "SwapFree: %zu kB", &free);
-        }
+void RAMStatus::render() const {
+    ImGui::Text("RAM Usage: %s / %s", 
+        formatSize(used).c_str(), 
+        formatSize(total).c_str());
+    ImGui::ProgressBar(usage_percent / 100.0f);
+}
 
-        if (total > 0) {
-            total *= 1024; // Convert from KB to bytes
-            free *= 1024;
-            used = total - free;
-            usage_percent = ((float)used / total) * 100.0f;
-        } else {
-            used = 0;
-            usage_percent = 0.0f;
-        }
+// SWAP Status implementation
+void SwapStatus::update(const MemInfo& info) {
+    if (info.swap_total > 0) {
+        total = info.swap_total * 1024; // Convert from KB to bytes
+        free = info.swap_free * 1024;
+        used = total - free;
+        usage_percent = ((float)used / total) * 100.0f;
+    } else {
+        total = used = free = 0;
+        usage_percent = 0.0f;
     }
+}
 
-    void render() {
-        ImGui::Text("SWAP Usage: %s / %s", 
-            formatSize(used).c_str(), 
-            formatSize(total).c_str());
-        ImGui::ProgressBar(usage_percent / 100.0f);
-    }
-};
+void SwapStatus::render() const {
+    ImGui::Text("SWAP Usage: %s / %s", 
+        formatSize(used).c_str(), 
+        formatSize(total).c_str());
+    ImGui::ProgressBar(usage_percent / 100.0f);
+}
 
 // Disk Status implementation
-struct DiskStatus {
-    size_t total;
-    size_t used;
-    size_t available;
-    float usage_percent;
-
-    void update() {
-        struct statvfs stat;
-        if (statvfs("/", &stat) == 0) {
-            total = stat.f_blocks * stat.f_frsize;
-            available = stat.f_bfree * stat.f_frsize;
-            used = total - available;
-            usage_percent = ((float)used / total) * 100.0f;
-        }
+void DiskStatus::update() {
+    struct statvfs stat;
+    const char* data;
+    size_t length;
+    bool ok;
+    if (g_capture.replaying()) {
+        ok = g_capture.fetch(CAPTURE_VALUE, "@statvfs:/", &data, &length) && data && length == sizeof(stat);
+        if (ok) memcpy(&stat, data, sizeof(stat));
+    } else {
+        ok = statvfs("/", &stat) == 0;
+        g_capture.store(CAPTURE_VALUE, "@statvfs:/", ok ? &stat : nullptr, sizeof(stat));
     }
+    if (ok) {
+        total = stat.f_blocks * stat.f_frsize;
+        available = stat.f_bfree * stat.f_frsize;
+        used = total - available;
+        usage_percent = ((float)used / total) * 100.0f;
+    }
+}
 
-    void render() {
-        ImGui::Text("Disk Usage: %s / %s", 
-            formatSize(used).c_str(), 
-            formatSize(total).c_str());
-        ImGui::ProgressBar(usage_percent / 100.0f);
+void DiskStatus::render() const {
+    ImGui::Text("Disk Usage: %s / %s", 
+        formatSize(used).c_str(), 
+        formatSize(total).c_str());
+    ImGui::ProgressBar(usage_percent / 100.0f);
+}
+
+// Breakdown of the kernel's memory accounting, collapsed by default
+static void renderMemInfoDetails(const MemInfo& info) {
+    if (!ImGui::TreeNode("Details")) return;
+
+    struct Row { const char* label; size_t kb; };
+    const Row rows[] = {
+        { "Buffers", info.buffers },
+        { "Cached", info.cached },
+        { "Swap Cached", info.swap_cached },
+        { "Active", info.active },
+        { "Inactive", info.inactive },
+        { "Dirty", info.dirty },
+        { "Writeback", info.writeback },
+        { "Shmem", info.shmem },
+        { "Slab", info.slab },
+        { "Slab Reclaimable", info.sreclaimable },
+        { "Page Tables", info.page_tables },
+        { "Committed", info.committed_as },
+    };
+
+    if (ImGui::BeginTable("MemInfoDetails", 2, ImGuiTableFlags_RowBg)) {
+        for (const Row& row : rows) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(row.label);
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", formatSize(row.kb * 1024).c_str());
+        }
+        ImGui::EndTable();
     }
-};
+    if (info.hugepages_total > 0) {
+        ImGui::Text("HugePages: %zu free / %zu total (%s each)",
+            info.hugepages_free, info.hugepages_total,
+            formatSize(info.hugepagesize * 1024).c_str());
+    }
+    ImGui::TreePop();
+}
+
+// RAM and swap usage over time, collapsed by default
+static void renderMemoryHistory() {
+    if (!ImGui::TreeNode("History")) return;
+
+    static HistorySpan span = SPAN_LIVE;
+    static const MetricHistory* ram_history = g_history.metric("memory.ram");
+    static const MetricHistory* swap_history = g_history.metric("memory.swap");
+    renderSpanSelector("Span##memory", span);
+    plotHistory("RAM %", ram_history, span, nullptr, 100.0f, ImVec2(0, 60));
+    plotHistory("Swap %", swap_history, span, nullptr, 100.0f, ImVec2(0, 60));
+    ImGui::TreePop();
+}
 
 // Memory and Process window implementation
-static RAMStatus ram_status;
-static SwapStatus swap_status;
-static DiskStatus disk_status;
 static ProcessManager process_manager;
+static MemInfoReader meminfo_reader;
 
 // Initialize the process manager
 static bool process_manager_initialized = false;
@@ -139,8 +248,27 @@ void initializeProcessManager() {
     }
 }
 
+// Collector entry points
+void sampleMemory(MemorySnapshot& snapshot) {
+    meminfo_reader.sample(snapshot.meminfo);
+    snapshot.ram.update(snapshot.meminfo);
+    snapshot.swap.update(snapshot.meminfo);
+
+    static MetricHistory* ram_history = g_history.metric("memory.ram");
+    static MetricHistory* swap_history = g_history.metric("memory.swap");
+    double now = monotonicSeconds();
+    g_history.record(ram_history, now, snapshot.ram.usage_percent);
+    g_history.record(swap_history, now, snapshot.swap.usage_percent);
+}
+
+void sampleProcesses(ProcessSnapshot& snapshot, const MemInfo& meminfo) {
+    process_manager.update(snapshot, meminfo.mem_total * 1024);
+}
+
 void memoryProcessesWindow(const char* id, ImVec2 size, ImVec2 position) {
     initializeProcessManager();
+    const MonitorSnapshot& current = g_collector.current();
+    const MemorySnapshot& snapshot = current.memory;
 
     ImGui::Begin(id);
     ImGui::SetWindowSize(id, size);
@@ -148,242 +276,630 @@ void memoryProcessesWindow(const char* id, ImVec2 size, ImVec2 position) {
 
     // Memory section
     ImGui::BeginChild("Memory", ImVec2(0, 100), true);
-    ram_status.update();
-    swap_status.update();
-    disk_status.update();
-    
-    ram_status.render();
-    swap_status.render();
-    disk_status.render();
+    snapshot.ram.render();
+    snapshot.swap.render();
+    snapshot.disk.render();
+    renderMemInfoDetails(snapshot.meminfo);
+    renderMemoryHistory();
     ImGui::EndChild();
 
     // Process table section
     ImGui::BeginChild("Processes", ImVec2(0, 0), true);
-    process_manager.update();
-    process_manager.render();
+    process_manager.render(current.processes);
     ImGui::EndChild();
 
     ImGui::End();
 }
 
-void ProcessManager::update() {
-    // Only update process list every 1 second to avoid interfering with filter input
-    float current_time = ImGui::GetTime();
-    if (current_time - last_update_time < 1.0f) {
-        return; // Skip update if less than 1 second has passed
+// Task flag set on kernel threads (include/linux/sched.h)
+static const long long PF_KTHREAD = 0x00200000;
+
+void SystemProcessStats::count(char state) {
+    total++;
+    switch (state) {
+        case 'R': running++; break;
+        case 'S': sleeping++; break;
+        case 'D': disk_sleep++; break;
+        case 'Z': zombie++; break;
+        case 'T':
+        case 't': stopped++; break;
+        case 'I': idle++; break;
     }
-    last_update_time = current_time;
-
-    DIR* proc_dir = opendir("/proc");
-    if (!proc_dir) return;
+}
 
-    processes.clear();
+const char* describeProcessState(char state) {
+    switch (state) {
+        case 'R': return "R (running)";
+        case 'S': return "S (sleeping)";
+        case 'D': return "D (disk sleep)";
+        case 'Z': return "Z (zombie)";
+        case 'T': return "T (stopped)";
+        case 't': return "t (tracing stop)";
+        case 'X': return "X (dead)";
+        case 'I': return "I (idle)";
+        case 'P': return "P (parked)";
+        default: return "?";
+    }
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(proc_dir)) != nullptr) {
-        if (!isdigit(entry->d_name[0])) continue;
-        
-        pid_t pid = atoi(entry->d_name);
-        ProcessInfo proc;
+// With proc events, how often to walk /proc anyway in case we missed something
+static const double PROCESS_RECONCILE_INTERVAL = 30.0;
+
+// Reads one pid's stat into the table and the state histogram. Kernel
+// threads are tracked (so event-driven scans can count them) but only get
+// metrics and rows when asked for.
+void ProcessManager::sampleProcess(pid_t pid, ProcessSnapshot& snapshot, bool want_kernel_threads) {
+    // The process might have terminated since we learned its pid
+    ProcStat stat;
+    if (!ProcessMetrics::readProcessStat(pid, stat)) return;
+    double sampled_at = monotonicSeconds();
+
+    bool born;
+    TrackedProcess& tracked = table.insert({pid, stat.starttime}, &born);
+    if (!born && tracked.seen_in_scan == scan) return;     // listed twice
+    tracked.seen_in_scan = scan;
+    snapshot.stats.count(stat.state);
+
+    ProcessInfo& proc = tracked.info;
+    if (born) {
         proc.pid = pid;
-        
-        // Get process name and state
-        string status_path = "/proc/" + string(entry->d_name) + "/status";
-        ifstream status_file(status_path);
-        string line;
-        
-        while (getline(status_file, line)) {
-            if (line.find("Name:") == 0) {
-                proc.name = line.substr(6);
-                // Trim whitespace
-                proc.name.erase(0, proc.name.find_first_not_of(" \t"));
-                proc.name.erase(proc.name.find_last_not_of(" \t") + 1);
-            }
-            else if (line.find("State:") == 0) {
-                proc.state = line.substr(7);
-                // Trim whitespace
-                proc.state.erase(0, proc.state.find_first_not_of(" \t"));
-                proc.state.erase(proc.state.find_last_not_of(" \t") + 1);
-            }
+        proc.kernel_thread = (stat.flags & PF_KTHREAD) != 0;
+        proc.last_stats = ProcessStats();
+        proc.sampled_at = 0.0;
+    }
+    // comm only changes on exec or prctl(PR_SET_NAME)
+    static_assert(sizeof(proc.name) == sizeof(stat.comm), "comm must fit the row's name");
+    if (born || strcmp(proc.name, stat.comm) != 0) {
+        memcpy(proc.name, stat.comm, sizeof(proc.name));
+    }
+    proc.state = stat.state;
+    proc.delay.valid = false;
+
+    // CPU, fault and memory metrics against this process's previous sample
+    ProcessStats current = ProcessMetrics::getProcessStats(stat);
+    if (!proc.kernel_thread || want_kernel_threads) {
+        double elapsed = born ? 0.0 : sampled_at - proc.sampled_at;
+        proc.metrics = accounting.compute(current, proc.last_stats, elapsed);
+    }
+    proc.last_stats = current;
+    proc.sampled_at = sampled_at;
+}
+
+// Taskstats counters only reset when the process is replaced
+static inline double taskDelta(uint64_t current, uint64_t previous) {
+    return current > previous ? (double)(current - previous) : 0.0;
+}
+
+// Turns two taskstats samples into delay percentages and I/O rates
+static TaskDelayMetrics computeTaskDelay(const TaskCounters& current,
+                                         const TaskCounters& previous,
+                                         double elapsed) {
+    TaskDelayMetrics delay{};
+    delay.valid = true;
+    if (elapsed <= 0.0) return delay;
+
+    double wall_ns = elapsed * 1e9;
+    delay.cpu_delay = (float)(taskDelta(current.cpu_delay, previous.cpu_delay) / wall_ns * 100.0);
+    delay.blkio_delay = (float)(taskDelta(current.blkio_delay, previous.blkio_delay) / wall_ns * 100.0);
+    delay.swapin_delay = (float)(taskDelta(current.swapin_delay, previous.swapin_delay) / wall_ns * 100.0);
+    delay.read_rate = (float)(taskDelta(current.read_bytes, previous.read_bytes) / elapsed);
+    delay.write_rate = (float)(taskDelta(current.write_bytes, previous.write_bytes) / elapsed);
+    return delay;
+}
+
+// Queries taskstats for the pids the UI is showing. Results land in
+// watched/task_counters/task_found, sorted by pid, for update() to merge.
+void ProcessManager::sampleTaskstats(ProcessSnapshot& snapshot) {
+    watched.clear();
+    if (!show_delay_accounting) {
+        // Closing unregisters the exit listener, so the kernel stops building
+        // a record for every exit; ticking the box again reopens it
+        if (taskstats.available()) taskstats.close();
+        taskstats_tried = false;
+        snapshot.taskstats_available = false;
+        return;
+    }
+    if (!taskstats_tried) {
+        taskstats_tried = true;
+        if (netlinkSourcesEnabled()) taskstats.open();
+    }
+    snapshot.taskstats_available = taskstats.available();
+    snapshot.delayacct_enabled = taskstats.available() && delayAccountingEnabled();
+    if (!taskstats.available()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        watched = watched_pids;
+    }
+    std::sort(watched.begin(), watched.end());
+    watched.erase(std::unique(watched.begin(), watched.end()), watched.end());
+    taskstats.query(watched, task_counters, task_found);
+    taskstats.collectExits(watched, task_counters, task_found);
+}
+
+// One pass builds both the state histogram and the table rows; everything
+// comes from /proc/[pid]/stat, so each pid costs a single read. The table
+// persists between scans: a scan only inserts new processes, updates what
+// changed and evicts the ones it did not see. When the proc connector is
+// available, the pids come from the table plus fork events instead of a
+// readdir(/proc), which then only runs periodically to reconcile.
+void ProcessManager::update(ProcessSnapshot& snapshot, size_t total_memory) {
+    double now = monotonicSeconds();
+    if (!events_tried) {
+        events_tried = true;
+        if (netlinkSourcesEnabled()) events.open();
+    }
+
+    forked.clear();
+    exited_pids.clear();
+    if (events.available() && !events.poll(forked, exited_pids)) {
+        rescan_needed = true;   // events were dropped
+    }
+    bool full_scan = rescan_needed || !events.available() ||
+                     now - last_full_scan >= PROCESS_RECONCILE_INTERVAL;
+
+    pending.clear();
+    if (full_scan) {
+        KernelDirectory proc_dir("/proc");
+        if (!proc_dir.isOpen()) return;
+        const char* name;
+        while ((name = proc_dir.next()) != nullptr) {
+            if (isdigit(name[0])) pending.push_back(atoi(name));
         }
+        rescan_needed = false;
+        last_full_scan = now;
+    } else {
+        // Everything we know about minus what exited, plus what was forked
+        std::sort(exited_pids.begin(), exited_pids.end());
+        table.forEach([&](const ProcessKey& key, TrackedProcess&) {
+            if (!std::binary_search(exited_pids.begin(), exited_pids.end(), key.pid)) {
+                pending.push_back(key.pid);
+            }
+        });
+        pending.insert(pending.end(), forked.begin(), forked.end());
+    }
+
+    snapshot.stats = SystemProcessStats();
+    snapshot.event_driven = events.available();
+    bool want_kernel_threads = show_kernel_threads;
+    accounting.refresh(total_memory);
+    scan++;
 
-        // Get CPU and memory metrics
-        try {
-            auto metrics = ProcessMetrics::getProcessMetrics(
-                ProcessMetrics::getProcessStats(pid),
-                last_stats[pid],
-                sysconf(_SC_CLK_TCK)
-            );
-            
-            proc.cpu_usage = metrics.cpu_usage;
-            proc.mem_usage = metrics.mem_usage;
-            proc.last_stats = ProcessMetrics::getProcessStats(pid);
-            last_stats[pid] = proc.last_stats;
+    for (pid_t pid : pending) {
+        sampleProcess(pid, snapshot, want_kernel_threads);
+    }
+    sampleTaskstats(snapshot);
+    double task_sampled_at = monotonicSeconds();
+
+    // Evict every process this scan did not see, then publish the survivors
+    exited.clear();
+    std::vector<ProcessInfo>& processes = snapshot.rows;
+    processes.clear();
+    auto mergeTaskstats = [&](pid_t pid, TrackedProcess& tracked) {
+        auto it = std::lower_bound(watched.begin(), watched.end(), pid);
+        if (it != watched.end() && *it == pid && task_found[it - watched.begin()]) {
+            const TaskCounters& counters = task_counters[it - watched.begin()];
+            double elapsed = tracked.task_sampled_at > 0.0 ? task_sampled_at - tracked.task_sampled_at : 0.0;
+            tracked.info.delay = computeTaskDelay(counters, tracked.task_counters, elapsed);
+            tracked.task_counters = counters;
+            tracked.task_sampled_at = task_sampled_at;
+            return true;
         }
-        catch (...) {
-            // Process might have terminated
-            continue;
+        // Dropped off screen: the next rate starts from a fresh sample
+        tracked.task_sampled_at = 0.0;
+        return false;
+    };
+    table.forEach([&](const ProcessKey& key, TrackedProcess& tracked) {
+        bool visible = !tracked.info.kernel_thread || want_kernel_threads;
+        if (tracked.seen_in_scan != scan) {
+            // A watched process reaped since the last scan has its final
+            // counters from its exit record: publish that last interval once,
+            // as a dead row, before it leaves the table
+            bool sampled = tracked.task_sampled_at > 0.0;
+            if (mergeTaskstats(key.pid, tracked) && sampled && visible) {
+                tracked.info.state = 'X';
+                processes.push_back(tracked.info);
+            }
+            exited.push_back(key);
+            return;
         }
-
-        processes.push_back(proc);
+        mergeTaskstats(key.pid, tracked);
+        if (visible) {
+            processes.push_back(tracked.info);
+        }
+    });
+    for (const ProcessKey& key : exited) {
+        table.erase(key);
     }
-    closedir(proc_dir);
 
-    // Sort processes by CPU usage
-    sort(processes.begin(), processes.end(),
-        [](const ProcessInfo& a, const ProcessInfo& b) {
-            return a.cpu_usage > b.cpu_usage;
-        });
+    snapshot.scan = scan;
 }
 
-void ProcessManager::render() {
+// Process table columns; the ids ImGui hands back in the sort specs
+enum ProcessColumn {
+    COLUMN_PID,
+    COLUMN_NAME,
+    COLUMN_STATE,
+    COLUMN_CPU,
+    COLUMN_HOST_CPU,
+    COLUMN_CHILD_CPU,
+    COLUMN_MINFLT,
+    COLUMN_MAJFLT,
+    COLUMN_MEMORY,
+    COLUMN_CPU_DELAY,
+    COLUMN_IO_DELAY,
+    COLUMN_SWAP_DELAY,
+    COLUMN_READ,
+    COLUMN_WRITE,
+};
+
+// Numeric sort key of a column; rows without taskstats sort below zero
+static double columnValue(const ProcessInfo& proc, int column) {
+    const TaskDelayMetrics& delay = proc.delay;
+    switch (column) {
+        case COLUMN_PID: return proc.pid;
+        case COLUMN_STATE: return proc.state;
+        case COLUMN_CPU: return proc.metrics.cpu_usage;
+        case COLUMN_HOST_CPU: return proc.metrics.cpu_host;
+        case COLUMN_CHILD_CPU: return proc.metrics.child_cpu;
+        case COLUMN_MINFLT: return proc.metrics.minflt_rate;
+        case COLUMN_MAJFLT: return proc.metrics.majflt_rate;
+        case COLUMN_MEMORY: return proc.metrics.mem_usage;
+        case COLUMN_CPU_DELAY: return delay.valid ? delay.cpu_delay : -1.0;
+        case COLUMN_IO_DELAY: return delay.valid ? delay.blkio_delay : -1.0;
+        case COLUMN_SWAP_DELAY: return delay.valid ? delay.swapin_delay : -1.0;
+        case COLUMN_READ: return delay.valid ? delay.read_rate : -1.0;
+        case COLUMN_WRITE: return delay.valid ? delay.write_rate : -1.0;
+        default: return 0.0;
+    }
+}
+
+void ProcessManager::render(const ProcessSnapshot& snapshot) {
+    const std::vector<ProcessInfo>& processes = snapshot.rows;
+
     // Filter input
-    ImGui::InputText("Filter", filter, sizeof(filter));
+    if (ImGui::InputText("Filter", filter, sizeof(filter))) view_dirty = true;
+    ImGui::SameLine();
+    bool kernel_threads = show_kernel_threads;
+    if (ImGui::Checkbox("Kernel threads", &kernel_threads)) {
+        show_kernel_threads = kernel_threads;
+    }
+    ImGui::SameLine();
+    bool delay_accounting = show_delay_accounting;
+    if (ImGui::Checkbox("Delay accounting", &delay_accounting)) {
+        show_delay_accounting = delay_accounting;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled(snapshot.event_driven ? "(proc events)" : "(polling)");
+
+    if (delay_accounting && snapshot.taskstats_available && !snapshot.delayacct_enabled) {
+        ImGui::TextDisabled("Delays need sysctl kernel.task_delayacct=1; I/O bytes are still counted");
+    } else if (delay_accounting && !snapshot.taskstats_available) {
+        ImGui::TextDisabled("Taskstats unavailable (needs CAP_NET_ADMIN)");
+    }
+    bool delay_columns = delay_accounting && snapshot.taskstats_available;
+    visible_pids.clear();
 
-    // Process table
-    if (ImGui::BeginTable("ProcessTable", 5, 
+    // Process table; scrolls inside itself so only visible rows are submitted
+    if (ImGui::BeginTable("ProcessTable", delay_columns ? 14 : 9, 
         ImGuiTableFlags_Resizable | 
         ImGuiTableFlags_Sortable | 
         ImGuiTableFlags_RowBg | 
-        ImGuiTableFlags_Borders)) {
+        ImGuiTableFlags_Borders |
+        ImGuiTableFlags_ScrollY)) {
         
-        ImGui::TableSetupColumn("PID");
-        ImGui::TableSetupColumn("Name");
-        ImGui::TableSetupColumn("State");
-        ImGui::TableSetupColumn("CPU %");
-        ImGui::TableSetupColumn("Memory %");
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("PID", 0, -1.0f, COLUMN_PID);
+        ImGui::TableSetupColumn("Name", 0, -1.0f, COLUMN_NAME);
+        ImGui::TableSetupColumn("State", 0, -1.0f, COLUMN_STATE);
+        ImGui::TableSetupColumn("CPU %", ImGuiTableColumnFlags_DefaultSort |
+                                ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_CPU);
+        ImGui::TableSetupColumn("Host CPU %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_HOST_CPU);
+        ImGui::TableSetupColumn("Child CPU %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_CHILD_CPU);
+        ImGui::TableSetupColumn("Min Flt/s", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_MINFLT);
+        ImGui::TableSetupColumn("Maj Flt/s", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_MAJFLT);
+        ImGui::TableSetupColumn("Memory %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_MEMORY);
+        if (delay_columns) {
+            ImGui::TableSetupColumn("CPU Delay %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_CPU_DELAY);
+            ImGui::TableSetupColumn("I/O Delay %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_IO_DELAY);
+            ImGui::TableSetupColumn("Swap Delay %", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_SWAP_DELAY);
+            ImGui::TableSetupColumn("Read/s", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_READ);
+            ImGui::TableSetupColumn("Write/s", ImGuiTableColumnFlags_PreferSortDescending, -1.0f, COLUMN_WRITE);
+        }
         ImGui::TableHeadersRow();
 
-        for (auto& proc : processes) {
-            if (!matchesFilter(proc)) continue;
-
-            ImGui::TableNextRow();
-            ImGui::TableNextColumn();
-            
-            if (ImGui::Selectable(std::to_string(proc.pid).c_str(), 
-                &proc.selected, ImGuiSelectableFlags_SpanAllColumns)) {
-                handleSelection(proc);
+        ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs();
+        if (sort_specs && sort_specs->SpecsDirty) {
+            if (sort_specs->SpecsCount > 0) {
+                sort_column = sort_specs->Specs[0].ColumnUserID;
+                sort_descending = sort_specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
             }
+            sort_specs->SpecsDirty = false;
+            view_dirty = true;
+        }
+        if (view_dirty || snapshot.scan != view_scan) rebuildView(snapshot);
 
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", proc.name.c_str());
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", proc.state.c_str());
-            ImGui::TableNextColumn();
-            ImGui::Text("%.1f", proc.cpu_usage);
-            ImGui::TableNextColumn();
-            ImGui::Text("%.1f", proc.mem_usage);
+        ImGuiListClipper clipper;
+        clipper.Begin((int)view.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                const ProcessInfo& proc = processes[view[row]];
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+
+                char pid[16];
+                snprintf(pid, sizeof(pid), "%d", proc.pid);
+                if (ImGui::Selectable(pid, isSelected(proc.pid), ImGuiSelectableFlags_SpanAllColumns)) {
+                    handleSelection(proc.pid);
+                }
+                if (delay_columns) visible_pids.push_back(proc.pid);
+
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(proc.name);
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(describeProcessState(proc.state));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", proc.metrics.cpu_usage);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", proc.metrics.cpu_host);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", proc.metrics.child_cpu);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.0f", proc.metrics.minflt_rate);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.0f", proc.metrics.majflt_rate);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", proc.metrics.mem_usage);
+
+                if (delay_columns) {
+                    ImGui::TableNextColumn();
+                    if (proc.delay.valid) ImGui::Text("%.1f", proc.delay.cpu_delay);
+                    ImGui::TableNextColumn();
+                    if (proc.delay.valid) ImGui::Text("%.1f", proc.delay.blkio_delay);
+                    ImGui::TableNextColumn();
+                    if (proc.delay.valid) ImGui::Text("%.1f", proc.delay.swapin_delay);
+                    ImGui::TableNextColumn();
+                    if (proc.delay.valid) ImGui::Text("%s/s", formatSize(proc.delay.read_rate).c_str());
+                    ImGui::TableNextColumn();
+                    if (proc.delay.valid) ImGui::Text("%s/s", formatSize(proc.delay.write_rate).c_str());
+                }
+            }
         }
         ImGui::EndTable();
     }
+
+    // Hand the collector what is on screen; selected rows stay watched
+    // even when filtered out or scrolled away
+    if (delay_columns) {
+        visible_pids.insert(visible_pids.end(), selected_pids.begin(), selected_pids.end());
+        watch(visible_pids);
+    }
+}
+
+void ProcessManager::watch(std::vector<pid_t>& pids) {
+    std::lock_guard<std::mutex> lock(watch_mutex);
+    watched_pids.swap(pids);
+}
+
+// Filters and sorts row indexes; ties keep pid order so rows do not jump
+void ProcessManager::rebuildView(const ProcessSnapshot& snapshot) {
+    const std::vector<ProcessInfo>& processes = snapshot.rows;
+    view.clear();
+    for (uint32_t i = 0; i < processes.size(); i++) {
+        if (matchesFilter(processes[i])) view.push_back(i);
+    }
+
+    int column = sort_column;
+    bool descending = sort_descending;
+    std::sort(view.begin(), view.end(), [&](uint32_t left, uint32_t right) {
+        const ProcessInfo& a = processes[left];
+        const ProcessInfo& b = processes[right];
+        int order = 0;
+        if (column == COLUMN_NAME) {
+            order = strcmp(a.name, b.name);
+        } else {
+            double x = columnValue(a, column), y = columnValue(b, column);
+            order = x < y ? -1 : x > y ? 1 : 0;
+        }
+        if (order == 0) return a.pid < b.pid;
+        return descending ? order > 0 : order < 0;
+    });
+
+    view_scan = snapshot.scan;
+    view_dirty = false;
 }
 
+// Allocation-free: runs over every row whenever the view is rebuilt
 bool ProcessManager::matchesFilter(const ProcessInfo& proc) {
-    if (strlen(filter) == 0) return true;
-    std::string filter_str(filter);
-    return proc.name.find(filter_str) != std::string::npos ||
-           std::to_string(proc.pid).find(filter_str) != std::string::npos;
+    if (filter[0] == '\0') return true;
+    if (strstr(proc.name, filter)) return true;
+    char pid[16];
+    snprintf(pid, sizeof(pid), "%d", proc.pid);
+    return strstr(pid, filter) != nullptr;
 }
 
-void ProcessManager::handleSelection(ProcessInfo& proc) {
-    // Toggle selection
-    proc.selected = !proc.selected;
-    
-    // Update selected PIDs list
-    if (proc.selected) {
-        selected_pids.push_back(proc.pid);
+bool ProcessManager::isSelected(pid_t pid) const {
+    return std::find(selected_pids.begin(), selected_pids.end(), pid) != selected_pids.end();
+}
+
+void ProcessManager::handleSelection(pid_t pid) {
+    // Toggle selection, keeping at most the three most recent picks
+    if (!isSelected(pid)) {
+        selected_pids.push_back(pid);
         if (selected_pids.size() > 3) {
-            // Deselect oldest selection
-            for (auto& p : processes) {
-                if (p.pid == selected_pids[0]) {
-                    p.selected = false;
-                    break;
-                }
-            }
             selected_pids.erase(selected_pids.begin());
         }
     } else {
         selected_pids.erase(
-            remove(selected_pids.begin(), selected_pids.end(), proc.pid),
+            remove(selected_pids.begin(), selected_pids.end(), pid),
             selected_pids.end()
         );
     }
 }
 
+// /proc/[pid]/stat fields after "pid (comm) state", in file order
+static long long ProcStat::* const PROC_STAT_FIELDS[] = {
+    &ProcStat::ppid, &ProcStat::pgrp, &ProcStat::session, &ProcStat::tty_nr,
+    &ProcStat::tpgid, &ProcStat::flags, &ProcStat::minflt, &ProcStat::cminflt,
+    &ProcStat::majflt, &ProcStat::cmajflt, &ProcStat::utime, &ProcStat::stime,
+    &ProcStat::cutime, &ProcStat::cstime, &ProcStat::priority, &ProcStat::nice,
+    &ProcStat::num_threads, &ProcStat::itrealvalue, &ProcStat::starttime, &ProcStat::vsize,
+    &ProcStat::rss, &ProcStat::rsslim, &ProcStat::startcode, &ProcStat::endcode,
+    &ProcStat::startstack, &ProcStat::kstkesp, &ProcStat::kstkeip, &ProcStat::signal,
+    &ProcStat::blocked, &ProcStat::sigignore, &ProcStat::sigcatch, &ProcStat::wchan,
+    &ProcStat::nswap, &ProcStat::cnswap, &ProcStat::exit_signal, &ProcStat::processor,
+    &ProcStat::rt_priority, &ProcStat::policy, &ProcStat::delayacct_blkio_ticks, &ProcStat::guest_time,
+    &ProcStat::cguest_time, &ProcStat::start_data, &ProcStat::end_data, &ProcStat::start_brk,
+    &ProcStat::arg_start, &ProcStat::arg_end, &ProcStat::env_start, &ProcStat::env_end,
+    &ProcStat::exit_code,
+};
+
+// Parses an optionally negative decimal, advancing p; unsigned values wider
+// than long long keep their bit pattern
+static inline bool parseStatNumber(const char*& p, const char* end, long long& value) {
+    while (p < end && *p == ' ') p++;
+    bool negative = (p < end && *p == '-');
+    if (negative) p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+
+    unsigned long long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+    value = (long long)(negative ? 0 - result : result);
+    return true;
+}
+
+bool parseProcStat(const char* text, size_t length, ProcStat& stat) {
+    const char* end = text + length;
+    const char* open = (const char*)memchr(text, '(', length);
+    const char* close = (const char*)memrchr(text, ')', length);
+    if (!open || !close || close < open) return false;
+
+    const char* p = text;
+    if (!parseStatNumber(p, open, stat.pid)) return false;
+
+    size_t comm_length = std::min<size_t>(close - open - 1, sizeof(stat.comm) - 1);
+    memcpy(stat.comm, open + 1, comm_length);
+    stat.comm[comm_length] = '\0';
+
+    p = close + 1;
+    while (p < end && *p == ' ') p++;
+    if (p >= end) return false;
+    stat.state = *p++;
+
+    const size_t field_count = sizeof(PROC_STAT_FIELDS) / sizeof(PROC_STAT_FIELDS[0]);
+    size_t field = 0;
+    for (; field < field_count; field++) {
+        if (!parseStatNumber(p, end, stat.*PROC_STAT_FIELDS[field])) break;
+    }
+    for (size_t i = field; i < field_count; i++) {
+        stat.*PROC_STAT_FIELDS[i] = 0;
+    }
+    // Everything through rss (field 24) has existed since 2.6
+    return field > 20;
+}
+
 // Also implement the ProcessMetrics static methods
-ProcessStats ProcessMetrics::getProcessStats(pid_t pid) {
-    ProcessStats stats{};
-    char path[256];
+bool ProcessMetrics::readProcessStat(pid_t pid, ProcStat& stat) {
+    char path[32];
     snprintf(path, sizeof(path), "/proc/%d/stat", pid);
 
-    FILE* file = fopen(path, "r");
-    if (!file) throw std::runtime_error("Could not open process stats");
-
-    // Read the entire line and parse fields
-    char line[1024];
-    if (fgets(line, sizeof(line), file)) {
-        char* token = strtok(line, " ");
-        int field = 1;
-
-        while (token && field <= 24) {
-            switch (field) {
-                case 14: stats.utime = atoll(token); break;
-                case 15: stats.stime = atoll(token); break;
-                case 16: stats.cutime = atoll(token); break;
-                case 17: stats.cstime = atoll(token); break;
-                case 22: stats.starttime = atoll(token); break;
-                case 23: stats.vsize = atoll(token); break;
-                case 24: stats.rss = atoll(token); break;
-            }
-            token = strtok(NULL, " ");
-            field++;
-        }
+    if (g_capture.replaying()) {
+        const char* data;
+        size_t length;
+        return g_capture.fetch(CAPTURE_FILE, path, &data, &length) && data && length > 0 &&
+               parseProcStat(data, length, stat);
     }
 
-    fclose(file);
+    char resolved[PATH_MAX];
+    int fd = open(resolveKernelPath(path, resolved), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        g_capture.store(CAPTURE_FILE, path, nullptr, 0);
+        return false;
+    }
+    char line[2048];
+    ssize_t length = read(fd, line, sizeof(line));
+    close(fd);
+    g_capture.store(CAPTURE_FILE, path, length >= 0 ? line : nullptr, std::max<ssize_t>(length, 0));
+
+    return length > 0 && parseProcStat(line, length, stat);
+}
+
+ProcessStats ProcessMetrics::getProcessStats(const ProcStat& stat) {
+    ProcessStats stats{};
+    stats.utime = stat.utime;
+    stats.stime = stat.stime;
+    stats.cutime = stat.cutime;
+    stats.cstime = stat.cstime;
+    stats.starttime = stat.starttime;
+    stats.vsize = stat.vsize;
+    stats.rss = stat.rss;
+    stats.minflt = stat.minflt;
+    stats.majflt = stat.majflt;
     return stats;
 }
 
-ProcessMetrics ProcessMetrics::getProcessMetrics(
+ProcessStats ProcessMetrics::getProcessStats(pid_t pid) {
+    ProcStat stat;
+    if (!readProcessStat(pid, stat)) throw std::runtime_error("Could not open process stats");
+    return getProcessStats(stat);
+}
+
+void ProcessAccounting::refresh(size_t total_memory) {
+    // Host constants travel with a capture; the replaying host may differ
+    long values[3];
+    const char* data;
+    size_t length;
+    if (g_capture.replaying() && g_capture.fetch(CAPTURE_VALUE, "@sysconf", &data, &length) &&
+        data && length == sizeof(values)) {
+        memcpy(values, data, sizeof(values));
+    } else {
+        values[0] = sysconf(_SC_CLK_TCK);
+        values[1] = sysconf(_SC_PAGE_SIZE);
+        values[2] = sysconf(_SC_NPROCESSORS_ONLN);
+        g_capture.store(CAPTURE_VALUE, "@sysconf", values, sizeof(values));
+    }
+    clk_tck = (double)values[0];
+    page_size = (double)values[1];
+    cpu_count = std::max(1L, values[2]);
+    this->total_memory = (double)total_memory;
+}
+
+// Counters never go backwards within one process incarnation; clamp in case
+// the previous sample belongs to a different one
+static inline double counterDelta(long long current, long long previous) {
+    return current > previous ? (double)(current - previous) : 0.0;
+}
+
+ProcessMetrics ProcessAccounting::compute(
     const ProcessStats& current,
-    const ProcessStats& last,
-    unsigned long clk_tck) {
+    const ProcessStats& previous,
+    double elapsed) const {
 
     ProcessMetrics metrics{};
 
-    // Calculate CPU usage (simplified - not time-based)
-    // Use a very basic approximation to avoid unrealistic high values
-    unsigned long total_time = current.utime + current.stime;
-    if (total_time > 0) {
-        // Much more conservative CPU estimation
-        metrics.cpu_usage = (float)(total_time % 100) / 100.0f; // 0.0% - 1.0% range
-    } else {
-        metrics.cpu_usage = 0.0f;
+    // Rates need an interval; a process seen for the first time has none yet
+    if (elapsed > 0.0) {
+        double cpu_seconds = counterDelta(current.utime + current.stime,
+                                          previous.utime + previous.stime) / clk_tck;
+        double child_seconds = counterDelta(current.cutime + current.cstime,
+                                            previous.cutime + previous.cstime) / clk_tck;
+
+        metrics.cpu_usage = (float)(cpu_seconds / elapsed * 100.0);
+        metrics.cpu_host = metrics.cpu_usage / cpu_count;
+        metrics.child_cpu = (float)(child_seconds / elapsed * 100.0);
+        metrics.minflt_rate = (float)(counterDelta(current.minflt, previous.minflt) / elapsed);
+        metrics.majflt_rate = (float)(counterDelta(current.majflt, previous.majflt) / elapsed);
     }
 
     // Calculate memory usage as percentage of total RAM
     // RSS from /proc/pid/stat is in pages, convert to bytes
-    long page_size = sysconf(_SC_PAGE_SIZE);
-    unsigned long process_memory_bytes = (unsigned long)current.rss * (unsigned long)page_size;
-
-    // Get total system memory (static to avoid repeated file reads)
-    static size_t total_memory = 0;
-    if (total_memory == 0) {
-        std::ifstream meminfo("/proc/meminfo");
-        std::string line;
-        while (std::getline(meminfo, line)) {
-            if (line.find("MemTotal:") == 0) {
-                sscanf(line.c_str(), "MemTotal: %zu kB", &total_memory);
-                total_memory *= 1024; // Convert to bytes
-                break;
-            }
-        }
-    }
-
+    double process_memory_bytes = (double)current.rss * page_size;
     if (total_memory > 0 && process_memory_bytes > 0) {
-        metrics.mem_usage = ((double)process_memory_bytes / (double)total_memory) * 100.0;
-    } else {
-        metrics.mem_usage = 0.0f;
+        metrics.mem_usage = (float)(process_memory_bytes / total_memory * 100.0);
     }
 
     return metrics;
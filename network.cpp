@@ -1,25 +1,30 @@
 #include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
 
-// Network interface data structure
-struct NetworkInterface {
-    std::string name;        // e.g., "lo", "wlp5s0"
-    std::string ipv4;        // IPv4 address
-    
-    // RX Statistics
-    RX rx;
-    // TX Statistics 
-    TX tx;
-
-    // History for graphs
-    std::vector<float> rx_history;
-    std::vector<float> tx_history;
-};
+// Without rtnetlink change notifications, how often addresses are re-read
+static const double ADDRESS_POLL_INTERVAL = 10.0;
 
 class NetworkMonitor {
 private:
-    std::vector<NetworkInterface> interfaces;
-    const float MAX_SCALE_GB = 2.0f; // 2GB scale for progress bars
-    const size_t HISTORY_SIZE = 100;  // Size of history for graphs
+    KernelFile proc_net_dev{"/proc/net/dev"};
+
+    // One rtnetlink socket for RTM_GETLINK dumps and one subscribed to link
+    // and address changes, so getifaddrs only runs when something changed
+    int rtnl_sock = -1;
+    int notify_sock = -1;
+    bool rtnl_tried = false;
+    uint32_t rtnl_sequence = 0;
+    std::vector<char> rtnl_buffer;
+    bool addresses_dirty = true;
+    double addresses_read_at = 0.0;
+
+    // UI thread: span of the throughput graphs
+    HistorySpan span = SPAN_LIVE;
 
     // Convert bytes to appropriate unit string (KB/MB/GB)
     std::string formatBytes(uint64_t bytes) {
@@ -38,108 +43,399 @@ private:
         return std::string(buffer);
     }
 
-    void updateInterfaces() {
+    // Finds an interface by name, adding it the first time it shows up.
+    // Interfaces persist across samples so their history does too.
+    NetworkInterface& findInterface(std::vector<NetworkInterface>& interfaces,
+                                    const char* name, size_t name_length) {
+        for (NetworkInterface& iface : interfaces) {
+            if (iface.name.compare(0, std::string::npos, name, name_length) == 0) {
+                iface.seen = true;
+                return iface;
+            }
+        }
+        interfaces.emplace_back();
+        NetworkInterface& iface = interfaces.back();
+        iface.name.assign(name, name_length);
+        iface.rx = RX{};
+        iface.tx = TX{};
+        iface.sampled_at = 0.0;
+        iface.seen = true;
+        iface.rx_history = g_history.metric("net." + iface.name + ".rx");
+        iface.tx_history = g_history.metric("net." + iface.name + ".tx");
+        addresses_dirty = true;
+        return iface;
+    }
+
+    bool openRtnetlink() {
+        rtnl_buffer.resize(64 * 1024);
+
+        rtnl_sock = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (rtnl_sock < 0) return false;
+        struct timeval timeout = {0, 200 * 1000};
+        setsockopt(rtnl_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        struct sockaddr_nl addr = {};
+        addr.nl_family = AF_NETLINK;
+        if (bind(rtnl_sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            closeRtnetlink();
+            return false;
+        }
+
+        // Without change notifications addresses fall back to polling
+        notify_sock = socket(PF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (notify_sock >= 0) {
+            addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+            if (bind(notify_sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+                ::close(notify_sock);
+                notify_sock = -1;
+            }
+        }
+        return true;
+    }
+
+    void closeRtnetlink() {
+        if (rtnl_sock >= 0) ::close(rtnl_sock);
+        if (notify_sock >= 0) ::close(notify_sock);
+        rtnl_sock = -1;
+        notify_sock = -1;
+    }
+
+    // Copies one link's counters, grouped the way /proc/net/dev prints them
+    // so switching between the two sources never moves a column
+    static void applyLinkStats(NetworkInterface& iface, const struct rtnl_link_stats64& stats) {
+        iface.rx.bytes = stats.rx_bytes;
+        iface.rx.packets = stats.rx_packets;
+        iface.rx.errs = stats.rx_errors;
+        iface.rx.drop = stats.rx_dropped + stats.rx_missed_errors;
+        iface.rx.fifo = stats.rx_fifo_errors;
+        iface.rx.frame = stats.rx_length_errors + stats.rx_over_errors +
+                         stats.rx_crc_errors + stats.rx_frame_errors;
+        iface.rx.compressed = stats.rx_compressed;
+        iface.rx.multicast = stats.multicast;
+
+        iface.tx.bytes = stats.tx_bytes;
+        iface.tx.packets = stats.tx_packets;
+        iface.tx.errs = stats.tx_errors;
+        iface.tx.drop = stats.tx_dropped;
+        iface.tx.fifo = stats.tx_fifo_errors;
+        iface.tx.colls = stats.collisions;
+        iface.tx.carrier = stats.tx_carrier_errors + stats.tx_aborted_errors +
+                           stats.tx_window_errors + stats.tx_heartbeat_errors;
+        iface.tx.compressed = stats.tx_compressed;
+    }
+
+    // One RTM_GETLINK dump returns every interface with its 64-bit counters
+    bool dumpLinks(std::vector<NetworkInterface>& interfaces) {
+        struct {
+            struct nlmsghdr header;
+            struct ifinfomsg info;
+        } request = {};
+        request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+        request.header.nlmsg_type = RTM_GETLINK;
+        request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        request.header.nlmsg_seq = ++rtnl_sequence;
+        request.info.ifi_family = AF_UNSPEC;
+        if (send(rtnl_sock, &request, request.header.nlmsg_len, 0) < 0) return false;
+
+        while (true) {
+            struct iovec iov = {rtnl_buffer.data(), rtnl_buffer.size()};
+            struct msghdr message = {};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            ssize_t length = recvmsg(rtnl_sock, &message, 0);
+            if (length < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (message.msg_flags & MSG_TRUNC) return false;
+
+            int remaining = (int)length;
+            for (struct nlmsghdr* header = (struct nlmsghdr*)rtnl_buffer.data();
+                 NLMSG_OK(header, remaining);
+                 header = NLMSG_NEXT(header, remaining)) {
+                if (header->nlmsg_seq != rtnl_sequence) continue;
+                if (header->nlmsg_type == NLMSG_DONE) return true;
+                if (header->nlmsg_type == NLMSG_ERROR) return false;
+                if (header->nlmsg_type != RTM_NEWLINK) continue;
+
+                struct ifinfomsg* info = (struct ifinfomsg*)NLMSG_DATA(header);
+                const char* name = nullptr;
+                struct rtnl_link_stats64 stats = {};
+                bool have_stats = false;
+
+                int attributes_length = IFLA_PAYLOAD(header);
+                for (struct rtattr* attribute = IFLA_RTA(info);
+                     RTA_OK(attribute, attributes_length);
+                     attribute = RTA_NEXT(attribute, attributes_length)) {
+                    if (attribute->rta_type == IFLA_IFNAME) {
+                        name = (const char*)RTA_DATA(attribute);
+                    } else if (attribute->rta_type == IFLA_STATS64) {
+                        memcpy(&stats, RTA_DATA(attribute),
+                               std::min<size_t>(RTA_PAYLOAD(attribute), sizeof(stats)));
+                        have_stats = true;
+                    }
+                }
+                if (!name || !have_stats) continue;
+
+                NetworkInterface& iface = findInterface(interfaces, name, strlen(name));
+                if (iface.index != info->ifi_index) {
+                    // Same name, new device: its counters start over
+                    iface.index = info->ifi_index;
+                    iface.sampled_at = 0.0;
+                }
+                applyLinkStats(iface, stats);
+            }
+        }
+    }
+
+    // Any link or address change means the cached addresses are stale
+    void drainNotifications() {
+        while (true) {
+            ssize_t length = recv(notify_sock, rtnl_buffer.data(), rtnl_buffer.size(), MSG_DONTWAIT);
+            if (length > 0) {
+                addresses_dirty = true;
+            } else if (length < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // ENOBUFS means notifications were lost, so refresh anyway
+                if (length < 0 && errno == ENOBUFS) addresses_dirty = true;
+                return;
+            }
+        }
+    }
+
+    // "name address\n" for every IPv4 address, so a capture can carry them
+    static bool listAddresses(std::string& listing) {
+        if (g_capture.replayValue("@ifaddrs", listing)) return true;
+
         struct ifaddrs *ifaddr, *ifa;
         if (getifaddrs(&ifaddr) == -1) {
             perror("getifaddrs");
-            return;
+            return false;
         }
-
-        // Clear old interfaces that might not exist anymore
-        interfaces.clear();
-        
+        listing.clear();
         for (ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
-            if (ifa->ifa_addr == nullptr) continue;
+            if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET) continue;
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET,
+                &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr,
+                ip, INET_ADDRSTRLEN);
+            listing.append(ifa->ifa_name).append(" ").append(ip).append("\n");
+        }
+        freeifaddrs(ifaddr);
+        g_capture.recordValue("@ifaddrs", listing);
+        return true;
+    }
 
-            if (ifa->ifa_addr->sa_family == AF_INET) {
-                NetworkInterface iface;
-                iface.name = ifa->ifa_name;
-                
-                char ip[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, 
-                    &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr,
-                    ip, INET_ADDRSTRLEN);
-                iface.ipv4 = ip;
-                
-                interfaces.push_back(iface);
+    void refreshAddresses(std::vector<NetworkInterface>& interfaces) {
+        std::string listing;
+        if (!listAddresses(listing)) return;
+
+        for (NetworkInterface& iface : interfaces) {
+            iface.ipv4.clear();
+        }
+        // The first address of an interface wins
+        const char* line = listing.c_str();
+        while (*line) {
+            const char* space = strchr(line, ' ');
+            const char* end = strchr(line, '\n');
+            if (!space || !end || space > end) break;
+            for (NetworkInterface& iface : interfaces) {
+                if (iface.ipv4.empty() && iface.name.compare(0, std::string::npos, line, space - line) == 0) {
+                    iface.ipv4.assign(space + 1, end - space - 1);
+                }
             }
+            line = end + 1;
         }
-        
-        freeifaddrs(ifaddr);
     }
 
-    void updateStatistics() {
-        std::ifstream netdev("/proc/net/dev");
-        std::string line;
-        
-        // Skip header lines
-        std::getline(netdev, line);
-        std::getline(netdev, line);
+    // Fallback when rtnetlink is unavailable
+    void readProcNetDev(std::vector<NetworkInterface>& interfaces) {
+        const char* netdev = proc_net_dev.read();
+        if (!netdev) return;
+
+        // Skip the two header lines
+        const char* line = strchr(netdev, '\n');
+        if (line) line = strchr(line + 1, '\n');
         
-        while (std::getline(netdev, line)) {
-            std::istringstream iss(line);
-            std::string name;
-            iss >> name;
-            
-            // Remove colon from interface name
-            name = name.substr(0, name.length() - 1);
-            
-            // Find the interface in our list
-            auto it = std::find_if(interfaces.begin(), interfaces.end(),
-                [&name](const NetworkInterface& iface) {
-                    return iface.name == name;
-                });
+        while (line && *++line) {
+            // "  name: rx_bytes rx_packets ... tx_compressed"
+            const char* colon = strchr(line, ':');
+            if (!colon) break;
+            const char* name = line;
+            while (*name == ' ') name++;
+            NetworkInterface& iface = findInterface(interfaces, name, colon - name);
+
+            const char* p = colon + 1;
+            line = strchr(p, '\n');
+
+            unsigned long long values[16] = {};
+            for (int i = 0; i < 16; i++) {
+                char* end;
+                values[i] = strtoull(p, &end, 10);
+                if (end == p) break;
+                p = end;
+            }
                 
-            if (it != interfaces.end()) {
-                // Read RX stats
-                iss >> it->rx.bytes >> it->rx.packets 
-                    >> it->rx.errs >> it->rx.drop
-                    >> it->rx.fifo >> it->rx.frame
-                    >> it->rx.compressed >> it->rx.multicast;
-                    
-                // Read TX stats
-                iss >> it->tx.bytes >> it->tx.packets
-                    >> it->tx.errs >> it->tx.drop
-                    >> it->tx.fifo >> it->tx.colls
-                    >> it->tx.carrier >> it->tx.compressed;
-
-                // Update history
-                if (it->rx_history.size() >= HISTORY_SIZE) {
-                    it->rx_history.erase(it->rx_history.begin());
-                    it->tx_history.erase(it->tx_history.begin());
-                }
+            // Read RX stats
+            iface.rx.bytes = values[0];
+            iface.rx.packets = values[1];
+            iface.rx.errs = values[2];
+            iface.rx.drop = values[3];
+            iface.rx.fifo = values[4];
+            iface.rx.frame = values[5];
+            iface.rx.compressed = values[6];
+            iface.rx.multicast = values[7];
                 
-                float rx_gb = it->rx.bytes / (1024.0f * 1024.0f * 1024.0f);
-                float tx_gb = it->tx.bytes / (1024.0f * 1024.0f * 1024.0f);
-                it->rx_history.push_back(rx_gb);
-                it->tx_history.push_back(tx_gb);
+            // Read TX stats
+            iface.tx.bytes = values[8];
+            iface.tx.packets = values[9];
+            iface.tx.errs = values[10];
+            iface.tx.drop = values[11];
+            iface.tx.fifo = values[12];
+            iface.tx.colls = values[13];
+            iface.tx.carrier = values[14];
+            iface.tx.compressed = values[15];
+        }
+    }
+
+    // Growth of a counter between two samples. Counters that went backwards
+    // either wrapped at 32 bits (older drivers, /proc/net/dev on 32-bit
+    // kernels) or were reset, e.g. by a driver reload; a reset yields no rate
+    // for that interval instead of a bogus spike.
+    static uint64_t counterDelta(uint64_t current, uint64_t previous) {
+        if (current >= previous) return current - previous;
+        if (previous <= UINT32_MAX && current <= UINT32_MAX) {
+            uint64_t wrapped = current + (1ULL << 32) - previous;
+            if (wrapped < (1ULL << 31)) return wrapped;
+        }
+        return 0;
+    }
+
+    void updateRates(std::vector<NetworkInterface>& interfaces, double now) {
+        for (NetworkInterface& iface : interfaces) {
+            double elapsed = iface.sampled_at > 0.0 ? now - iface.sampled_at : 0.0;
+            InterfaceRates& rates = iface.rates;
+            rates = InterfaceRates{};
+            if (elapsed > 0.0) {
+                const RX& rx = iface.rx;
+                const RX& old_rx = iface.previous_rx;
+                const TX& tx = iface.tx;
+                const TX& old_tx = iface.previous_tx;
+                rates.rx_bytes = (float)(counterDelta(rx.bytes, old_rx.bytes) / elapsed);
+                rates.tx_bytes = (float)(counterDelta(tx.bytes, old_tx.bytes) / elapsed);
+                rates.rx_packets = (float)(counterDelta(rx.packets, old_rx.packets) / elapsed);
+                rates.tx_packets = (float)(counterDelta(tx.packets, old_tx.packets) / elapsed);
+                rates.rx_errors = (float)(counterDelta(rx.errs, old_rx.errs) / elapsed);
+                rates.tx_errors = (float)(counterDelta(tx.errs, old_tx.errs) / elapsed);
+                rates.rx_drops = (float)(counterDelta(rx.drop, old_rx.drop) / elapsed);
+                rates.tx_drops = (float)(counterDelta(tx.drop, old_tx.drop) / elapsed);
+
+                g_history.record(iface.rx_history, now, rates.rx_bytes);
+                g_history.record(iface.tx_history, now, rates.tx_bytes);
             }
+            iface.previous_rx = iface.rx;
+            iface.previous_tx = iface.tx;
+            iface.sampled_at = now;
         }
     }
 
-    void renderProgressBar(const std::string& label, float value_gb) {
-        float fraction = value_gb / MAX_SCALE_GB;
-        fraction = std::min(fraction, 1.0f); // Clamp to max scale
-        
-        ImGui::Text("%s", label.c_str());
-        ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f));
+    static std::string formatRate(double bytes_per_second) {
+        char buffer[32];
+        if (bytes_per_second >= 1024.0 * 1024.0 * 1024.0) {
+            snprintf(buffer, sizeof(buffer), "%.2f GB/s", bytes_per_second / (1024.0 * 1024.0 * 1024.0));
+        } else if (bytes_per_second >= 1024.0 * 1024.0) {
+            snprintf(buffer, sizeof(buffer), "%.2f MB/s", bytes_per_second / (1024.0 * 1024.0));
+        } else if (bytes_per_second >= 1024.0) {
+            snprintf(buffer, sizeof(buffer), "%.2f KB/s", bytes_per_second / 1024.0);
+        } else {
+            snprintf(buffer, sizeof(buffer), "%.0f B/s", bytes_per_second);
+        }
+        return std::string(buffer);
+    }
+
+    // Throughput graph scaled to its own peak, with the peak sample marked
+    void renderRateGraph(const char* id, const MetricHistory* history) {
+        HistoryView view = plotHistory(id, history, span, nullptr, 0.0f,
+                                       ImVec2(-1.0f, 60.0f), 1024.0f);    // at least 1 KB/s
+        if (view.count == 0) return;
+
+        // PlotLines spreads samples across the frame, minus its padding
+        ImVec2 min = ImGui::GetItemRectMin();
+        ImVec2 max = ImGui::GetItemRectMax();
+        ImVec2 padding = ImGui::GetStyle().FramePadding;
+        float left = min.x + padding.x, right = max.x - padding.x;
+        float top = min.y + padding.y, bottom = max.y - padding.y;
+        float t = view.count > 1 ? (float)view.peak_index / (view.count - 1) : 0.0f;
+        ImVec2 marker(left + t * (right - left),
+                      bottom - std::min(view.peak / view.scale_max, 1.0f) * (bottom - top));
+
+        ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotLinesHovered);
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        draw_list->AddCircleFilled(marker, 3.0f, color);
+        std::string label = "peak " + formatRate(view.peak);
+        float label_x = std::min(marker.x + 5.0f, right - ImGui::CalcTextSize(label.c_str()).x);
+        draw_list->AddText(ImVec2(label_x, top), color, label.c_str());
     }
 
 public:
-    void update() {
-        updateInterfaces();
-        updateStatistics();
+    ~NetworkMonitor() {
+        closeRtnetlink();
+    }
+
+    // Collector thread
+    void update(NetworkSnapshot& snapshot) {
+        std::vector<NetworkInterface>& interfaces = snapshot.interfaces;
+        if (!rtnl_tried) {
+            rtnl_tried = true;
+            // Captures and fixture roots only have /proc/net/dev
+            if (netlinkSourcesEnabled()) openRtnetlink();
+        }
+
+        for (NetworkInterface& iface : interfaces) {
+            iface.seen = false;
+        }
+        snapshot.rtnetlink = rtnl_sock >= 0 && dumpLinks(interfaces);
+        if (!snapshot.rtnetlink) {
+            readProcNetDev(interfaces);
+        }
+        for (const NetworkInterface& iface : interfaces) {
+            if (!iface.seen) {
+                g_history.release("net." + iface.name + ".rx");
+                g_history.release("net." + iface.name + ".tx");
+            }
+        }
+        interfaces.erase(
+            std::remove_if(interfaces.begin(), interfaces.end(),
+                [](const NetworkInterface& iface) { return !iface.seen; }),
+            interfaces.end());
+
+        double now = monotonicSeconds();
+        if (notify_sock >= 0) {
+            drainNotifications();
+        } else if (now - addresses_read_at >= ADDRESS_POLL_INTERVAL) {
+            addresses_dirty = true;
+        }
+        if (addresses_dirty) {
+            refreshAddresses(interfaces);
+            addresses_dirty = false;
+            addresses_read_at = now;
+        }
+
+        updateRates(interfaces, now);
     }
 
-    void renderInterfaces() {
+    // UI thread
+
+    void renderInterfaces(const std::vector<NetworkInterface>& interfaces) {
         for (const auto& iface : interfaces) {
             if (ImGui::CollapsingHeader(iface.name.c_str())) {
-                ImGui::Text("IPv4: %s", iface.ipv4.c_str());
+                ImGui::Text("IPv4: %s", iface.ipv4.empty() ? "none" : iface.ipv4.c_str());
             }
         }
     }
 
-    void renderRXTable() {
+    void renderRXTable(const std::vector<NetworkInterface>& interfaces) {
         if (ImGui::BeginTable("RX_Stats", 8, 
             ImGuiTableFlags_Borders | 
             ImGuiTableFlags_Resizable | 
@@ -160,26 +456,26 @@ public:
                 ImGui::TableNextColumn();
                 ImGui::Text("%s", formatBytes(iface.rx.bytes).c_str());
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.packets);
+                ImGui::Text("%" PRIu64, iface.rx.packets);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.errs);
+                ImGui::Text("%" PRIu64, iface.rx.errs);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.drop);
+                ImGui::Text("%" PRIu64, iface.rx.drop);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.fifo);
+                ImGui::Text("%" PRIu64, iface.rx.fifo);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.frame);
+                ImGui::Text("%" PRIu64, iface.rx.frame);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.compressed);
+                ImGui::Text("%" PRIu64, iface.rx.compressed);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.rx.multicast);
+                ImGui::Text("%" PRIu64, iface.rx.multicast);
             }
             
             ImGui::EndTable();
         }
     }
 
-    void renderTXTable() {
+    void renderTXTable(const std::vector<NetworkInterface>& interfaces) {
         if (ImGui::BeginTable("TX_Stats", 8, 
             ImGuiTableFlags_Borders | 
             ImGuiTableFlags_Resizable | 
@@ -200,38 +496,42 @@ public:
                 ImGui::TableNextColumn();
                 ImGui::Text("%s", formatBytes(iface.tx.bytes).c_str());
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.packets);
+                ImGui::Text("%" PRIu64, iface.tx.packets);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.errs);
+                ImGui::Text("%" PRIu64, iface.tx.errs);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.drop);
+                ImGui::Text("%" PRIu64, iface.tx.drop);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.fifo);
+                ImGui::Text("%" PRIu64, iface.tx.fifo);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.colls);
+                ImGui::Text("%" PRIu64, iface.tx.colls);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.carrier);
+                ImGui::Text("%" PRIu64, iface.tx.carrier);
                 ImGui::TableNextColumn();
-                ImGui::Text("%d", iface.tx.compressed);
+                ImGui::Text("%" PRIu64, iface.tx.compressed);
             }
             
             ImGui::EndTable();
         }
     }
 
-    void renderRXVisualizations() {
+    void renderRXVisualizations(const std::vector<NetworkInterface>& interfaces) {
+        renderSpanSelector("Span##rx", span);
         for (const auto& iface : interfaces) {
-            float rx_gb = iface.rx.bytes / (1024.0f * 1024.0f * 1024.0f);
-            std::string label = iface.name + " RX: " + formatBytes(iface.rx.bytes);
-            renderProgressBar(label, rx_gb);
+            const InterfaceRates& rates = iface.rates;
+            ImGui::Text("%s RX: %s  %.0f pkt/s  %.0f err/s  %.0f drop/s", iface.name.c_str(),
+                formatRate(rates.rx_bytes).c_str(), rates.rx_packets, rates.rx_errors, rates.rx_drops);
+            renderRateGraph(("##rx_" + iface.name).c_str(), iface.rx_history);
         }
     }
 
-    void renderTXVisualizations() {
+    void renderTXVisualizations(const std::vector<NetworkInterface>& interfaces) {
+        renderSpanSelector("Span##tx", span);
         for (const auto& iface : interfaces) {
-            float tx_gb = iface.tx.bytes / (1024.0f * 1024.0f * 1024.0f);
-            std::string label = iface.name + " TX: " + formatBytes(iface.tx.bytes);
-            renderProgressBar(label, tx_gb);
+            const InterfaceRates& rates = iface.rates;
+            ImGui::Text("%s TX: %s  %.0f pkt/s  %.0f err/s  %.0f drop/s", iface.name.c_str(),
+                formatRate(rates.tx_bytes).c_str(), rates.tx_packets, rates.tx_errors, rates.tx_drops);
+            renderRateGraph(("##tx_" + iface.name).c_str(), iface.tx_history);
         }
     }
 };
@@ -239,32 +539,36 @@ public:
 // Global network monitor instance
 static NetworkMonitor networkMonitor;
 
+// Collector entry point
+void sampleNetwork(NetworkSnapshot& snapshot) {
+    networkMonitor.update(snapshot);
+}
+
 void networkWindow(const char* id, ImVec2 size, ImVec2 position) {
+    const std::vector<NetworkInterface>& interfaces = g_collector.current().network.interfaces;
+
     ImGui::Begin(id);
     ImGui::SetWindowSize(id, size);
     ImGui::SetWindowPos(id, position);
 
-    // Update network statistics
-    networkMonitor.update();
-
     // Network interfaces section
     if (ImGui::BeginTabBar("NetworkTabs")) {
         if (ImGui::BeginTabItem("Interfaces")) {
-            networkMonitor.renderInterfaces();
+            networkMonitor.renderInterfaces(interfaces);
             ImGui::EndTabItem();
         }
         
         if (ImGui::BeginTabItem("RX")) {
-            networkMonitor.renderRXTable();
+            networkMonitor.renderRXTable(interfaces);
             ImGui::Spacing();
-            networkMonitor.renderRXVisualizations();
+            networkMonitor.renderRXVisualizations(interfaces);
             ImGui::EndTabItem();
         }
         
         if (ImGui::BeginTabItem("TX")) {
-            networkMonitor.renderTXTable();
+            networkMonitor.renderTXTable(interfaces);
             ImGui::Spacing();
-            networkMonitor.renderTXVisualizations();
+            networkMonitor.renderTXVisualizations(interfaces);
             ImGui::EndTabItem();
         }
         
@@ -0,0 +1,99 @@
+#include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+ProcEventListener::~ProcEventListener() {
+    close();
+}
+
+bool ProcEventListener::open() {
+    if (sock >= 0) return true;
+
+    sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock < 0) return false;
+
+    // Fork storms arrive faster than one drain per tick; give the queue room
+    int rcvbuf = 1 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0;    // let the kernel pick our port id
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close();
+        return false;
+    }
+
+    // Ask the connector to start multicasting process events
+    char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] = {};
+    struct nlmsghdr* header = (struct nlmsghdr*)request;
+    header->nlmsg_len = sizeof(request);
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = getpid();
+
+    struct cn_msg* message = (struct cn_msg*)NLMSG_DATA(header);
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(enum proc_cn_mcast_op);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(message->data, &op, sizeof(op));
+
+    if (send(sock, request, sizeof(request), 0) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ProcEventListener::close() {
+    if (sock >= 0) ::close(sock);
+    sock = -1;
+}
+
+bool ProcEventListener::poll(std::vector<pid_t>& forked, std::vector<pid_t>& exited) {
+    if (sock < 0) return false;
+
+    char buffer[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    while (true) {
+        ssize_t length = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            // ENOBUFS: the receive queue overflowed and events were lost
+            return false;
+        }
+
+        int remaining = (int)length;
+        for (struct nlmsghdr* header = (struct nlmsghdr*)buffer;
+             NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+
+            struct cn_msg* message = (struct cn_msg*)NLMSG_DATA(header);
+            if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+            const struct proc_event* event = (const struct proc_event*)message->data;
+
+            // Threads share their leader's /proc entry, so only whole processes matter
+            switch (event->what) {
+                case proc_event::PROC_EVENT_FORK:
+                    if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid) {
+                        forked.push_back(event->event_data.fork.child_tgid);
+                    }
+                    break;
+                case proc_event::PROC_EVENT_EXIT:
+                    if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                        exited.push_back(event->event_data.exit.process_tgid);
+                    }
+                    break;
+                default:
+                    // exec and comm changes are picked up when the pid's stat is re-read
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include "header.h"
+#include <cerrno>
+#include <fcntl.h>
+
+static const size_t INITIAL_BUFFER_SIZE = 4096;
+
+static std::string g_kernel_root;
+
+void setKernelRoot(const std::string& root) {
+    g_kernel_root = root;
+    while (!g_kernel_root.empty() && g_kernel_root.back() == '/') g_kernel_root.pop_back();
+}
+
+const std::string& kernelRoot() {
+    return g_kernel_root;
+}
+
+const char* resolveKernelPath(const char* path, char (&resolved)[PATH_MAX]) {
+    if (g_kernel_root.empty()) return path;
+    snprintf(resolved, sizeof(resolved), "%s%s", g_kernel_root.c_str(), path);
+    return resolved;
+}
+
+bool netlinkSourcesEnabled() {
+    return g_kernel_root.empty() && g_capture.mode() == KernelCapture::LIVE;
+}
+
+double monotonicSeconds() {
+    if (g_capture.replaying()) {
+        const char* data;
+        size_t length;
+        double seconds;
+        if (!g_capture.fetch(CAPTURE_CLOCK, "", &data, &length) || !data || length != sizeof(seconds)) {
+            return g_capture.taskTime();
+        }
+        memcpy(&seconds, data, sizeof(seconds));
+        return seconds;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = now.tv_sec + now.tv_nsec / 1e9;
+    g_capture.store(CAPTURE_CLOCK, "", &seconds, sizeof(seconds));
+    return seconds;
+}
+
+KernelFile::KernelFile(const std::string& path) : path(path), buffer(INITIAL_BUFFER_SIZE) {}
+
+KernelFile::~KernelFile() {
+    if (fd >= 0) close(fd);
+}
+
+bool KernelFile::reopen() {
+    if (fd >= 0) close(fd);
+    char resolved[PATH_MAX];
+    fd = open(resolveKernelPath(path.c_str(), resolved), O_RDONLY | O_CLOEXEC);
+    return fd >= 0;
+}
+
+const char* KernelFile::read(size_t* length) {
+    size_t size = 0;
+    const char* data;
+    if (g_capture.replaying()) {
+        data = replay(size);
+    } else {
+        data = readLive(size);
+        g_capture.store(CAPTURE_FILE, path.c_str(), data, size);
+    }
+    if (data && length) *length = size;
+    return data;
+}
+
+// The recorded bytes, copied so they are NUL-terminated like a live read
+const char* KernelFile::replay(size_t& length) {
+    const char* data;
+    if (!g_capture.fetch(CAPTURE_FILE, path.c_str(), &data, &length) || !data) return nullptr;
+    if (buffer.size() < length + 1) buffer.resize(length + 1);
+    memcpy(buffer.data(), data, length);
+    buffer[length] = '\0';
+    return buffer.data();
+}
+
+const char* KernelFile::readLive(size_t& length) {
+    if (fd < 0 && !reopen()) return nullptr;
+
+    bool reopened = false;
+    size_t total = 0;
+    while (true) {
+        ssize_t n = pread(fd, buffer.data() + total, buffer.size() - total - 1, total);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // The file (or the device/process behind it) was replaced: retry once on a fresh descriptor
+            bool stale = (errno == ENOENT || errno == ESTALE || errno == ENODEV || errno == ESRCH);
+            if (stale && !reopened && reopen()) {
+                reopened = true;
+                total = 0;
+                continue;
+            }
+            return nullptr;
+        }
+        total += n;
+        if (n == 0 || total < buffer.size() - 1) break;
+        // Filled the buffer: grow it and keep reading where we stopped
+        buffer.resize(buffer.size() * 2);
+    }
+
+    buffer[total] = '\0';
+    length = total;
+    return buffer.data();
+}
+
+const char* KernelFileCache::read(const std::string& path, size_t* length) {
+    auto it = files.find(path);
+    if (it == files.end()) {
+        it = files.emplace(std::piecewise_construct,
+                           std::forward_as_tuple(path),
+                           std::forward_as_tuple(path)).first;
+    }
+    return it->second.read(length);
+}
+
+void KernelFileCache::forget(const std::string& path) {
+    files.erase(path);
+}
@@ -0,0 +1,166 @@
+#include "header.h"
+#include <fcntl.h>
+#include <sys/resource.h>
+
+// Largest value kept apart; anything slower lands in the last bucket
+static const uint64_t MAX_TRACKED_NS = (1ull << 37) - 1;
+
+Profiler g_profiler;
+
+const char* describeProfileScope(ProfileScope scope) {
+    switch (scope) {
+        case SCOPE_SYSTEM_INFO: return "System info";
+        case SCOPE_CPU: return "CPU (/proc/stat)";
+        case SCOPE_FAN: return "Fan";
+        case SCOPE_THERMAL: return "Thermal";
+        case SCOPE_MEMINFO: return "Meminfo";
+        case SCOPE_STATVFS: return "Disk (statvfs)";
+        case SCOPE_PROCESS_SCAN: return "Process scan";
+        case SCOPE_NETWORK: return "Network";
+        case SCOPE_SYSTEM_WINDOW: return "System window";
+        case SCOPE_MEMORY_WINDOW: return "Memory and Processes window";
+        case SCOPE_NETWORK_WINDOW: return "Network window";
+        case SCOPE_OVERHEAD_WINDOW: return "Overhead window";
+        case SCOPE_FRAME: return "Frame";
+        default: return "?";
+    }
+}
+
+// Values below SUB_BUCKETS get a bucket each; above, the position of the
+// top bit picks a group of SUB_BUCKETS and the next four bits the bucket
+static int bucketIndex(uint64_t ns) {
+    const int sub = LatencyHistogram::SUB_BUCKETS;
+    if (ns < (uint64_t)sub) return (int)ns;
+    int shift = 63 - __builtin_clzll(ns) - 4;
+    return (shift + 1) * sub + (int)((ns >> shift) & (sub - 1));
+}
+
+// Middle of the bucket's range
+static uint64_t bucketValue(int index) {
+    const int sub = LatencyHistogram::SUB_BUCKETS;
+    int group = index / sub;
+    uint64_t low = index % sub;
+    if (group == 0) return low;
+    int shift = group - 1;
+    return ((sub + low) << shift) + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    ns = std::min(ns, MAX_TRACKED_NS);
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    // Single writer, so a plain compare is enough
+    if (ns > maximum.load(std::memory_order_relaxed)) {
+        maximum.store(ns, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+// Counts can move while this walks them; the answer is then off by the
+// samples recorded meanwhile, which is fine for display
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t count = total.load(std::memory_order_relaxed);
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * count));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketValue(i), max());
+    }
+    return max();
+}
+
+void Profiler::reset() {
+    for (LatencyHistogram& histogram : histograms) {
+        histogram.reset();
+    }
+}
+
+// Always the live process, whatever --root or --replay say about the host
+void Profiler::sampleSelf() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = now.tv_sec + now.tv_nsec / 1e9;
+    if (last_sample > 0.0 && wall - last_sample < 1.0) return;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                 usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    if (last_sample > 0.0) {
+        cpu_percent = (float)((cpu - last_cpu) * 100.0 / (wall - last_sample));
+    }
+    last_sample = wall;
+    last_cpu = cpu;
+
+    // statm: size resident shared ..., in pages
+    static int statm = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    char text[128];
+    ssize_t length = statm >= 0 ? pread(statm, text, sizeof(text) - 1, 0) : -1;
+    if (length > 0) {
+        text[length] = '\0';
+        unsigned long size, resident;
+        if (sscanf(text, "%lu %lu", &size, &resident) == 2) {
+            rss_bytes = resident * (size_t)sysconf(_SC_PAGE_SIZE);
+        }
+    }
+}
+
+static void histogramCell(uint64_t ns) {
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f", ns / 1e6);
+}
+
+void overheadWindow(const char* id, ImVec2 size, ImVec2 position) {
+    ScopedTimer timer(SCOPE_OVERHEAD_WINDOW);
+    g_profiler.sampleSelf();
+
+    // Starts collapsed in a corner; after that it stays where the user puts it
+    ImGui::SetNextWindowPos(position, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(size, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin(id)) {
+        ImGui::End();
+        return;
+    }
+
+    const LatencyHistogram& frame = g_profiler.histogram(SCOPE_FRAME);
+    ImGui::Text("CPU: %.1f%% of one core   RSS: %.1f MB", g_profiler.cpuPercent(),
+                g_profiler.rssBytes() / (1024.0 * 1024.0));
+    ImGui::Text("Frame: p50 %.2f ms  p99 %.2f ms  max %.2f ms  (%llu frames)",
+                frame.percentile(0.50) / 1e6, frame.percentile(0.99) / 1e6, frame.max() / 1e6,
+                (unsigned long long)frame.count());
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Reset")) g_profiler.reset();
+
+    if (ImGui::BeginTable("Overhead", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("p50 (ms)");
+        ImGui::TableSetupColumn("p99 (ms)");
+        ImGui::TableSetupColumn("Max (ms)");
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < SCOPE_COUNT; i++) {
+            const LatencyHistogram& histogram = g_profiler.histogram((ProfileScope)i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(describeProfileScope((ProfileScope)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)histogram.count());
+            histogramCell(histogram.percentile(0.50));
+            histogramCell(histogram.percentile(0.99));
+            histogramCell(histogram.max());
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
@@ -2,174 +2,375 @@
 #include <sstream>
 #include <algorithm>
 
-// System information structures
-struct SystemInfo {
-    std::string os_type;
-    std::string logged_user;
-    std::string hostname;
-    std::string cpu_model;
+// Graph controls, owned by the UI thread. The collector reads `fps` (as the
+// sampling rate) and `animate`, so those two are atomic.
+struct GraphControls {
+    std::atomic<float> fps;
+    float scale;
+    std::atomic<bool> animate;
+    HistorySpan span;
+
+    GraphControls(float fps, float scale) : fps(fps), scale(scale), animate(true), span(SPAN_LIVE) {}
 };
 
-struct SystemProcessStats {
-    int total = 0;
-    int running = 0;
-    int sleeping = 0;
-    int zombie = 0;
-    int stopped = 0;
+// Sampling state, owned by the collector thread
+static KernelFile g_proc_stat("/proc/stat");
+static KernelFileCache g_sensor_files;
+
+// Where the last fan reading came from, so later samples go straight to the
+// cached descriptors instead of rescanning hwmon and thermal every second
+struct FanSensor {
+    FanSource source = FAN_SOURCE_NONE;
+    std::string speed_path;     // fan*_input, or cooling_device*/cur_state
+    std::string level_path;     // pwm1, or cooling_device*/max_state
+    int retry_in = 0;           // samples until the next discovery after a miss
 };
-
-struct CPUData {
-    std::vector<float> usage_history;
-    float current_usage = 0.0f;
-    float fps = 60.0f;
-    float scale = 100.0f;
-    bool animate = true;
-    CPUStats last_stats;
-    CPUStats current_stats;
-};
-
-struct FanData {
-    bool enabled = false;
-    int speed = 0;
-    int level = 0;
-    std::vector<float> history;
-    float fps = 60.0f;
-    float scale = 5000.0f;
-    bool animate = true;
-};
-
-struct ThermalData {
-    float current_temp = 0.0f;
-    std::vector<float> history;
-    float fps = 60.0f;
-    float scale = 100.0f;
-    bool animate = true;
-};
-
-// Global data
-static SystemInfo g_system_info;
-static SystemProcessStats g_process_stats;
-static CPUData g_cpu_data;
-static FanData g_fan_data;
-static ThermalData g_thermal_data;
+static FanSensor g_fan_sensor;
+static const int FAN_DISCOVERY_BACKOFF = 30;
+// /proc/version and /proc/cpuinfo do not change while we run; cpuinfo is the
+// largest file the collector would read, so both are read only once
+static bool g_static_info_read = false;
+
+// UI state
+static GraphControls g_cpu_controls(20.0f, 100.0f);
+static GraphControls g_fan_controls(1.0f, 5000.0f);
+static GraphControls g_thermal_controls(1.0f, 100.0f);
+
+float systemSampleRate(SampleTask task) {
+    switch (task) {
+        case TASK_CPU: return g_cpu_controls.fps;
+        case TASK_FAN: return g_fan_controls.fps;
+        case TASK_THERMAL: return g_thermal_controls.fps;
+        default: return 1.0f;
+    }
+}
 
 // Helper functions
 std::string readFileContent(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) return "";
+    const char* data;
+    size_t length;
+    if (g_capture.replaying()) {
+        if (!g_capture.fetch(CAPTURE_FILE, path.c_str(), &data, &length) || !data) return "";
+        return std::string(data, length);
+    }
+
+    char resolved[PATH_MAX];
+    std::ifstream file(resolveKernelPath(path.c_str(), resolved));
+    if (!file.is_open()) {
+        g_capture.store(CAPTURE_FILE, path.c_str(), nullptr, 0);
+        return "";
+    }
     
     std::stringstream buffer;
     buffer << file.rdbuf();
-    return buffer.str();
+    std::string content = buffer.str();
+    g_capture.store(CAPTURE_FILE, path.c_str(), content.data(), content.size());
+    return content;
 }
 
 // System information functions
-void updateSystemInfo() {
-    // Get OS Type from /proc/version
-    std::string version = readFileContent("/proc/version");
-    if (!version.empty()) {
-        size_t pos = version.find("Linux");
-        g_system_info.os_type = (pos != std::string::npos) ? "Linux" : "Unknown";
+void updateSystemInfo(SystemInfo& info) {
+    if (!g_static_info_read) {
+        g_static_info_read = true;
+
+        // Get OS Type from /proc/version
+        std::string version = readFileContent("/proc/version");
+        if (!version.empty()) {
+            size_t pos = version.find("Linux");
+            info.os_type = (pos != std::string::npos) ? "Linux" : "Unknown";
+        }
+
+        // Get CPU Model
+        std::string cpuinfo = readFileContent("/proc/cpuinfo");
+        size_t pos = cpuinfo.find("model name");
+        if (pos != std::string::npos) {
+            size_t end = cpuinfo.find("\n", pos);
+            size_t start = cpuinfo.find(":", pos) + 2;
+            info.cpu_model = cpuinfo.substr(start, end - start);
+        }
     }
 
     // Get logged user
-    char* user = getlogin();
-    g_system_info.logged_user = user ? user : "unknown";
+    if (!g_capture.replayValue("@login", info.logged_user)) {
+        char* user = getlogin();
+        info.logged_user = user ? user : "unknown";
+        g_capture.recordValue("@login", info.logged_user);
+    }
 
     // Get hostname
-    char hostname[HOST_NAME_MAX];
-    if (gethostname(hostname, HOST_NAME_MAX) == 0) {
-        g_system_info.hostname = hostname;
+    if (!g_capture.replayValue("@hostname", info.hostname)) {
+        char hostname[HOST_NAME_MAX];
+        if (gethostname(hostname, HOST_NAME_MAX) == 0) {
+            info.hostname = hostname;
+        }
+        g_capture.recordValue("@hostname", info.hostname);
     }
+}
+
+// Raw /proc/stat counters of one sample, owned by the collector thread.
+// Row 0 is the aggregate "cpu" line, row i + 1 the i-th cpuN line.
+struct CPUTicks {
+    std::vector<int> ids;                       // -1 for the aggregate row
+    std::vector<uint64_t> ticks[CPU_STATE_COUNT];
+
+    void clear() {
+        ids.clear();
+        for (std::vector<uint64_t>& column : ticks) column.clear();
+    }
+};
 
-    // Get CPU Model
-    std::string cpuinfo = readFileContent("/proc/cpuinfo");
-    size_t pos = cpuinfo.find("model name");
-    if (pos != std::string::npos) {
-        size_t end = cpuinfo.find("\n", pos);
-        size_t start = cpuinfo.find(":", pos) + 2;
-        g_system_info.cpu_model = cpuinfo.substr(start, end - start);
+const char* describeCPUState(CPUState state) {
+    switch (state) {
+        case CPU_USER: return "user";
+        case CPU_NICE: return "nice";
+        case CPU_SYSTEM: return "system";
+        case CPU_IDLE: return "idle";
+        case CPU_IOWAIT: return "iowait";
+        case CPU_IRQ: return "irq";
+        case CPU_SOFTIRQ: return "softirq";
+        case CPU_STEAL: return "steal";
+        case CPU_GUEST: return "guest";
+        case CPU_GUEST_NICE: return "guest_nice";
+        default: return "?";
     }
 }
 
-// Process statistics functions
-void updateProcessStats() {
-    g_process_stats = SystemProcessStats(); // Reset counters
-    
-    DIR* proc_dir = opendir("/proc");
-    if (!proc_dir) return;
+// Appends the row that starts at p ("cpu " or "cpuN ") and returns the
+// start of the next line. Columns older kernels lack are left 0.
+static const char* parseCPULine(const char* p, const char* end, CPUTicks& sample) {
+    p += 3;
+    int id = -1;
+    if (p < end && *p >= '0' && *p <= '9') {
+        id = 0;
+        while (p < end && *p >= '0' && *p <= '9') id = id * 10 + (*p++ - '0');
+    }
+    sample.ids.push_back(id);
+    for (int state = 0; state < CPU_STATE_COUNT; state++) {
+        while (p < end && *p == ' ') p++;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        sample.ticks[state].push_back(value);
+    }
+    while (p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(proc_dir)) != nullptr) {
-        // Skip non-process entries
-        if (!isdigit(entry->d_name[0])) continue;
+static CPUTicks g_cpu_ticks, g_last_cpu_ticks;
 
-        std::string status_path = "/proc/" + std::string(entry->d_name) + "/status";
-        std::string status = readFileContent(status_path);
-        
-        if (status.find("State:\tR") != std::string::npos) g_process_stats.running++;
-        else if (status.find("State:\tS") != std::string::npos) g_process_stats.sleeping++;
-        else if (status.find("State:\tZ") != std::string::npos) g_process_stats.zombie++;
-        else if (status.find("State:\tT") != std::string::npos) g_process_stats.stopped++;
-        
-        g_process_stats.total++;
+// One pass over /proc/stat: the aggregate line, then every cpuN line
+float calculateCPUUsage(CPUData& cpu) {
+    size_t length;
+    const char* stat = g_proc_stat.read(&length);
+    if (!stat) return 0.0f;
+
+    CPUTicks& sample = g_cpu_ticks;
+    sample.clear();
+    const char* end = stat + length;
+    const char* p = stat;
+    while (end - p > 3 && strncmp(p, "cpu", 3) == 0) {
+        p = parseCPULine(p, end, sample);
+    }
+    if (sample.ids.empty() || sample.ids[0] != -1) return 0.0f;
+
+    // Core list changed (hotplug) or first sample: nothing to diff against
+    size_t cores = sample.ids.size() - 1;
+    bool comparable = g_last_cpu_ticks.ids == sample.ids;
+    cpu.core_ids.assign(sample.ids.begin() + 1, sample.ids.end());
+    cpu.core_usage.assign(cores, 0.0f);
+    for (std::vector<float>& column : cpu.core_states) column.assign(cores, 0.0f);
+
+    // The aggregate row lands in cpu.states, the cores in the SoA columns
+    float usage = 0.0f;
+    if (comparable) {
+        CPUDeltaKernel kernel = bestCPUDeltaKernel();
+        CPUDeltaColumns columns;
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            columns.current[state] = sample.ticks[state].data();
+            columns.previous[state] = g_last_cpu_ticks.ticks[state].data();
+            columns.shares[state] = cpu.states + state;
+        }
+        columns.busy = &usage;
+        columns.count = 1;
+        computeCPUDeltas(columns, kernel);
+
+        for (int state = 0; state < CPU_STATE_COUNT; state++) {
+            columns.current[state]++;
+            columns.previous[state]++;
+            columns.shares[state] = cpu.core_states[state].data();
+        }
+        columns.busy = cpu.core_usage.data();
+        columns.count = cores;
+        computeCPUDeltas(columns, kernel);
+    } else {
+        std::fill(cpu.states, cpu.states + CPU_STATE_COUNT, 0.0f);
     }
-    closedir(proc_dir);
+
+    std::swap(g_cpu_ticks, g_last_cpu_ticks);
+    return usage;
 }
 
-// CPU usage calculation
-float calculateCPUUsage() {
-    std::string stat = readFileContent("/proc/stat");
-    std::istringstream iss(stat);
-    std::string cpu;
-    CPUStats stats;
+// Update functions for graphs
+void updateCPUData(CPUData& cpu) {
+    if (!g_cpu_controls.animate) return;
     
-    iss >> cpu 
-        >> stats.user >> stats.nice >> stats.system 
-        >> stats.idle >> stats.iowait >> stats.irq 
-        >> stats.softirq >> stats.steal >> stats.guest 
-        >> stats.guestNice;
+    float usage = calculateCPUUsage(cpu);
+    cpu.current_usage = usage;
+    static MetricHistory* history = g_history.metric("cpu.usage");
+    g_history.record(history, monotonicSeconds(), usage);
+}
 
-    if (cpu != "cpu") return 0.0f;
+// Parses the leading integer of a cached sensor file
+static bool readSensorInt(const std::string& path, int& value) {
+    const char* text = g_sensor_files.read(path);
+    if (!text) return false;
+    char* end;
+    long parsed = strtol(text, &end, 10);
+    if (end == text) return false;
+    value = (int)parsed;
+    return true;
+}
 
-    long long int prev_idle = g_cpu_data.last_stats.idle + g_cpu_data.last_stats.iowait;
-    long long int idle = stats.idle + stats.iowait;
+// Method 1: ThinkPad-specific fan interface
+static bool readThinkpadFan(FanData& fan) {
+    const char* fan_data = g_sensor_files.read("/proc/acpi/ibm/fan");
+    if (!fan_data) return false;
 
-    long long int prev_non_idle = g_cpu_data.last_stats.user + g_cpu_data.last_stats.nice + 
-                                 g_cpu_data.last_stats.system + g_cpu_data.last_stats.irq +
-                                 g_cpu_data.last_stats.softirq + g_cpu_data.last_stats.steal;
-    
-    long long int non_idle = stats.user + stats.nice + stats.system + 
-                            stats.irq + stats.softirq + stats.steal;
+    bool fan_found = false;
+    const char* status = strstr(fan_data, "status:");
+    if (status) {
+        const char* eol = strchr(status, '\n');
+        const char* disabled = strstr(status, "disabled");
+        fan.enabled = !(disabled && (!eol || disabled < eol));
+    }
+    const char* speed = strstr(fan_data, "speed:");
+    if (speed) {
+        char* end;
+        long value = strtol(speed + 6, &end, 10);
+        if (end != speed + 6) {
+            fan.speed = (int)value;
+            fan_found = true;
+        }
+    }
+    return fan_found;
+}
 
-    long long int prev_total = prev_idle + prev_non_idle;
-    long long int total = idle + non_idle;
+// Method 2: generic hwmon fan input, with optional PWM level
+static bool readHwmonFan(FanData& fan, const FanSensor& sensor) {
+    int speed;
+    if (!readSensorInt(sensor.speed_path, speed) || speed < 0) return false;
+    fan.speed = speed;
+    fan.enabled = (speed > 0);
 
-    long long int total_diff = total - prev_total;
-    long long int idle_diff = idle - prev_idle;
+    int pwm;
+    if (readSensorInt(sensor.level_path, pwm)) {
+        fan.level = pwm * 100 / 255;
+    }
+    return true;
+}
 
-    g_cpu_data.last_stats = stats;
+// Method 3: thermal cooling devices (CPU throttling/fan control)
+static bool readCoolingDevice(FanData& fan, const FanSensor& sensor) {
+    int current, maximum;
+    if (!readSensorInt(sensor.speed_path, current) ||
+        !readSensorInt(sensor.level_path, maximum)) return false;
+
+    // Convert cooling state to appropriate display values
+    // Higher cooling state = more active cooling
+    if (maximum <= 0) return false;
+    fan.speed = current; // Use raw cooling state (0-3)
+    fan.level = (current * 100) / maximum;  // Percentage
+    fan.enabled = (current > 0);
+    return true;
+}
 
-    if (total_diff == 0) return 0.0f;
-    return (float)(total_diff - idle_diff) * 100.0f / (float)total_diff;
+static bool readFanSensor(FanData& fan, const FanSensor& sensor) {
+    switch (sensor.source) {
+        case FAN_SOURCE_DIRECT: return readThinkpadFan(fan);
+        case FAN_SOURCE_HWMON: return readHwmonFan(fan, sensor);
+        case FAN_SOURCE_COOLING: return readCoolingDevice(fan, sensor);
+        default: return false;
+    }
 }
 
-// Update functions for graphs
-void updateCPUData() {
-    if (!g_cpu_data.animate) return;
-    
-    float usage = calculateCPUUsage();
-    g_cpu_data.current_usage = usage;
-    g_cpu_data.usage_history.push_back(usage);
-    
-    // Keep history at reasonable size
-    if (g_cpu_data.usage_history.size() > 100) {
-        g_cpu_data.usage_history.erase(g_cpu_data.usage_history.begin());
+// Walks the known fan interfaces in order of preference and remembers the first that works
+static bool discoverFanSensor(FanData& fan, FanSensor& sensor) {
+    sensor = FanSensor();
+
+    sensor.source = FAN_SOURCE_DIRECT;
+    if (readThinkpadFan(fan)) return true;
+    g_sensor_files.forget("/proc/acpi/ibm/fan");
+
+    const std::vector<std::string> hwmon_paths = {
+        "/sys/class/hwmon",
+        "/sys/devices/platform/coretemp.0/hwmon",
+        "/sys/devices/platform/it87.2608/hwmon",
+        "/sys/devices/platform/nct6775.2592/hwmon"
+    };
+
+    for (const auto& base_path : hwmon_paths) {
+        KernelDirectory hwmon(base_path.c_str());
+        if (!hwmon.isOpen()) continue;
+
+        bool found = false;
+        const char* name;
+        while (!found && (name = hwmon.next()) != nullptr) {
+            if (name[0] == '.') continue;
+
+            std::string device_path = base_path + "/" + name + "/";
+            
+            // Try different fan input files
+            const std::vector<std::string> fan_files = {
+                "fan1_input",
+                "fan2_input",
+                "fan3_input"
+            };
+
+            for (const auto& fan_file : fan_files) {
+                if (!kernelPathExists((device_path + fan_file).c_str(), R_OK)) continue;
+                sensor.source = FAN_SOURCE_HWMON;
+                sensor.speed_path = device_path + fan_file;
+                sensor.level_path = device_path + "pwm1";
+                if (readHwmonFan(fan, sensor)) {
+                    found = true;
+                    break;
+                }
+                g_sensor_files.forget(sensor.speed_path);
+            }
+        }
+        if (found) return true;
+    }
+
+    KernelDirectory thermal("/sys/class/thermal");
+    if (thermal.isOpen()) {
+        bool found = false;
+        const char* name;
+        while (!found && (name = thermal.next()) != nullptr) {
+            if (strncmp(name, "cooling_device", 14) != 0) continue;
+
+            std::string path = "/sys/class/thermal/" + std::string(name) + "/";
+            std::string type = readFileContent(path + "type");
+
+            // Check if it's a processor cooling device (CPU throttling)
+            if (type.find("Processor") != std::string::npos ||
+                type.find("processor") != std::string::npos ||
+                type.find("Fan") != std::string::npos ||
+                type.find("fan") != std::string::npos) {
+                sensor.source = FAN_SOURCE_COOLING;
+                sensor.speed_path = path + "cur_state";
+                sensor.level_path = path + "max_state";
+                found = readCoolingDevice(fan, sensor);
+            }
+        }
+        if (found) return true;
     }
+
+    sensor = FanSensor();
+    return false;
 }
 
-void updateFanData() {
-    if (!g_fan_data.animate) return;
+void updateFanData(FanData& fan) {
+    if (!g_fan_controls.animate) return;
+    static MetricHistory* history = g_history.metric("fan.speed");
     
     // Try to detect fan capabilities if not already checked
     static bool fan_capability_checked = false;
@@ -185,7 +386,7 @@ void updateFanData() {
         };
         
         for (const auto& path : possible_paths) {
-            if (access(path.c_str(), F_OK) == 0) {
+            if (kernelPathExists(path.c_str())) {
                 fan_monitoring_available = true;
                 break;
             }
@@ -200,255 +401,196 @@ void updateFanData() {
     
     // If no fan monitoring is available, use simulated/placeholder data
     if (!fan_monitoring_available) {
-        g_fan_data.enabled = false;
-        g_fan_data.speed = 0;
-        g_fan_data.level = 0;
-        g_fan_data.history.push_back(0.0f);
-        if (g_fan_data.history.size() > 100) {
-            g_fan_data.history.erase(g_fan_data.history.begin());
-        }
+        fan.source = FAN_SOURCE_NONE;
+        fan.enabled = false;
+        fan.speed = 0;
+        fan.level = 0;
+        g_history.record(history, monotonicSeconds(), 0.0f);
         return;
     }
     
-    bool fan_found = false;
-
-    // Method 1: Try ThinkPad-specific fan interface
-    std::string fan_data = readFileContent("/proc/acpi/ibm/fan");
-    if (!fan_data.empty()) {
-        std::istringstream iss(fan_data);
-        std::string line;
-        while (std::getline(iss, line)) {
-            if (line.find("status:") != std::string::npos) {
-                g_fan_data.enabled = (line.find("disabled") == std::string::npos);
-            }
-            else if (line.find("speed:") != std::string::npos) {
-                size_t pos = line.find(":");
-                if (pos != std::string::npos) {
-                    std::string speed_str = line.substr(pos + 1);
-                    speed_str.erase(0, speed_str.find_first_not_of(" \t\r\n"));
-                    try {
-                        g_fan_data.speed = std::stoi(speed_str);
-                        fan_found = true;
-                    } catch (...) {}
-                }
-            }
-        }
-    }
-
-    // Method 2: Try generic hwmon interface
-    if (!fan_found) {
-        const std::vector<std::string> hwmon_paths = {
-            "/sys/class/hwmon",
-            "/sys/devices/platform/coretemp.0/hwmon",
-            "/sys/devices/platform/it87.2608/hwmon",
-            "/sys/devices/platform/nct6775.2592/hwmon"
-        };
-
-        for (const auto& base_path : hwmon_paths) {
-            DIR* hwmon = opendir(base_path.c_str());
-            if (!hwmon) continue;
-
-            struct dirent* entry;
-            while ((entry = readdir(hwmon)) != nullptr) {
-                if (entry->d_name[0] == '.') continue;
-
-                std::string device_path = base_path + "/" + entry->d_name + "/";
-                
-                // Try different fan input files
-                const std::vector<std::string> fan_files = {
-                    "fan1_input",
-                    "fan2_input",
-                    "fan3_input"
-                };
-
-                for (const auto& fan_file : fan_files) {
-                    std::string speed_str = readFileContent(device_path + fan_file);
-                    if (!speed_str.empty()) {
-                        try {
-                            int speed = std::stoi(speed_str);
-                            if (speed >= 0) {
-                                g_fan_data.speed = speed;
-                                g_fan_data.enabled = (speed > 0);
-                                fan_found = true;
-                                break;
-                            }
-                        } catch (...) {}
-                    }
-                }
-
-                if (fan_found) {
-                    // Try to read PWM value
-                    std::string pwm_str = readFileContent(device_path + "pwm1");
-                    if (!pwm_str.empty()) {
-                        try {
-                            g_fan_data.level = std::stoi(pwm_str) * 100 / 255;
-                        } catch (...) {}
-                    }
-                    break;
-                }
-            }
-            closedir(hwmon);
-            if (fan_found) break;
-        }
-    }
-
-    // Method 3: Try thermal cooling devices (CPU throttling/fan control)
-    if (!fan_found) {
-        DIR* thermal = opendir("/sys/class/thermal");
-        if (thermal) {
-            struct dirent* entry;
-            while ((entry = readdir(thermal)) != nullptr) {
-                if (strncmp(entry->d_name, "cooling_device", 14) == 0) {
-                    std::string path = "/sys/class/thermal/" + std::string(entry->d_name) + "/";
-                    std::string type = readFileContent(path + "type");
-                    std::string cur_state = readFileContent(path + "cur_state");
-                    std::string max_state = readFileContent(path + "max_state");
-
-                    // Check if it's a processor cooling device (CPU throttling)
-                    if (type.find("Processor") != std::string::npos ||
-                        type.find("processor") != std::string::npos ||
-                        type.find("Fan") != std::string::npos ||
-                        type.find("fan") != std::string::npos) {
-                        try {
-                            int current = std::stoi(cur_state);
-                            int maximum = std::stoi(max_state);
-
-                            // Convert cooling state to appropriate display values
-                            // Higher cooling state = more active cooling
-                            if (maximum > 0) {
-                                g_fan_data.speed = current; // Use raw cooling state (0-3)
-                                g_fan_data.level = (current * 100) / maximum;  // Percentage
-                                g_fan_data.enabled = (current > 0);
-                                fan_found = true;
-                                break;
-                            }
-                        } catch (...) {}
-                    }
-                }
-            }
-            closedir(thermal);
-        }
+    // Re-read the sensor found last time; rediscover (rate limited) if it stopped working
+    bool fan_found = readFanSensor(fan, g_fan_sensor);
+    if (!fan_found && g_fan_sensor.retry_in-- <= 0) {
+        fan_found = discoverFanSensor(fan, g_fan_sensor);
+        if (!fan_found) g_fan_sensor.retry_in = FAN_DISCOVERY_BACKOFF;
     }
 
     // If no fan data found, mark as inactive
-    if (!fan_found) {
-        g_fan_data.enabled = false;
-        g_fan_data.speed = 0;
-        g_fan_data.level = 0;
+    if (fan_found) {
+        fan.source = g_fan_sensor.source;
+    } else {
+        fan.source = FAN_SOURCE_NONE;
+        fan.enabled = false;
+        fan.speed = 0;
+        fan.level = 0;
     }
 
     // Update history
-    g_fan_data.history.push_back(static_cast<float>(g_fan_data.speed));
-    if (g_fan_data.history.size() > 100) {
-        g_fan_data.history.erase(g_fan_data.history.begin());
-    }
-
-  }
+    g_history.record(history, monotonicSeconds(), static_cast<float>(fan.speed));
+}
 
-void updateThermalData() {
-    if (!g_thermal_data.animate) return;
+void updateThermalData(ThermalData& thermal) {
+    if (!g_thermal_controls.animate) return;
 
     // Try reading from /sys/class/thermal first
-    std::string temp_str = readFileContent("/sys/class/thermal/thermal_zone0/temp");
-    if (!temp_str.empty()) {
-        g_thermal_data.current_temp = std::stof(temp_str) / 1000.0f; // Convert from millicelsius
+    const char* temp_str = g_sensor_files.read("/sys/class/thermal/thermal_zone0/temp");
+    if (temp_str) {
+        thermal.current_temp = strtof(temp_str, nullptr) / 1000.0f; // Convert from millicelsius
     } else {
-        // Fallback to /proc/acpi/ibm/thermal
-        temp_str = readFileContent("/proc/acpi/ibm/thermal");
-        if (!temp_str.empty()) {
-            std::istringstream iss(temp_str);
-            std::string temperatures;
-            iss >> temperatures;
-            g_thermal_data.current_temp = std::stof(temperatures);
+        // Fallback to /proc/acpi/ibm/thermal ("temperatures:\t45 ...")
+        temp_str = g_sensor_files.read("/proc/acpi/ibm/thermal");
+        if (temp_str) {
+            const char* value = strchr(temp_str, ':');
+            thermal.current_temp = strtof(value ? value + 1 : temp_str, nullptr);
         }
     }
 
-    g_thermal_data.history.push_back(g_thermal_data.current_temp);
-    if (g_thermal_data.history.size() > 100) {
-        g_thermal_data.history.erase(g_thermal_data.history.begin());
-    }
+    static MetricHistory* history = g_history.metric("thermal.temp");
+    g_history.record(history, monotonicSeconds(), thermal.current_temp);
 }
 
 // Render functions
-void renderSystemInfo() {
-    ImGui::Text("OS Type: %s", g_system_info.os_type.c_str());
-    ImGui::Text("User: %s", g_system_info.logged_user.c_str());
-    ImGui::Text("Hostname: %s", g_system_info.hostname.c_str());
-    ImGui::Text("CPU Model: %s", g_system_info.cpu_model.c_str());
+void renderSystemInfo(const SystemInfo& info, const SystemProcessStats& stats) {
+    ImGui::Text("OS Type: %s", info.os_type.c_str());
+    ImGui::Text("User: %s", info.logged_user.c_str());
+    ImGui::Text("Hostname: %s", info.hostname.c_str());
+    ImGui::Text("CPU Model: %s", info.cpu_model.c_str());
     
     ImGui::Separator();
     
     ImGui::Text("Processes:");
-    ImGui::Text("Total: %d", g_process_stats.total);
-    ImGui::Text("Running: %d", g_process_stats.running);
-    ImGui::Text("Sleeping: %d", g_process_stats.sleeping);
-    ImGui::Text("Zombie: %d", g_process_stats.zombie);
-    ImGui::Text("Stopped: %d", g_process_stats.stopped);
-}
-
-void renderCPUTab() {
-    // FPS Slider
-    ImGui::SliderFloat("FPS##cpu", &g_cpu_data.fps, 1.0f, 60.0f);
-    
-    // Scale Slider
-    ImGui::SliderFloat("Scale##cpu", &g_cpu_data.scale, 0.0f, 100.0f);
-    
-    // Animation Toggle
-    ImGui::Checkbox("Animate##cpu", &g_cpu_data.animate);
-    
-    // CPU Usage Graph
-    ImGui::PlotLines("CPU Usage", 
-        g_cpu_data.usage_history.data(), 
-        g_cpu_data.usage_history.size(),
-        0, 
-        ("CPU: " + std::to_string(g_cpu_data.current_usage) + "%").c_str(),
-        0.0f, 
-        g_cpu_data.scale,
-        ImVec2(0, 80));
+    ImGui::Text("Total: %d", stats.total);
+    ImGui::Text("Running: %d", stats.running);
+    ImGui::Text("Sleeping: %d", stats.sleeping);
+    ImGui::Text("Disk Sleep: %d", stats.disk_sleep);
+    ImGui::Text("Idle: %d", stats.idle);
+    ImGui::Text("Zombie: %d", stats.zombie);
+    ImGui::Text("Stopped: %d", stats.stopped);
 }
 
-void renderFanTab() {
-    // FPS Slider
-    ImGui::SliderFloat("FPS##fan", &g_fan_data.fps, 1.0f, 60.0f);
+// Slider/checkbox row shared by the three graph tabs
+static void renderGraphControls(GraphControls& controls, const char* suffix, float max_scale) {
+    char label[32];
 
-    // Scale Slider - adjust range based on monitoring type
-    static bool has_cooling_device = (access("/sys/class/thermal/cooling_device0", F_OK) == 0);
-    static bool has_direct_fan = (access("/proc/acpi/ibm/fan", F_OK) == 0);
+    // FPS Slider: how often the collector samples this graph
+    snprintf(label, sizeof(label), "FPS##%s", suffix);
+    float fps = controls.fps;
+    if (ImGui::SliderFloat(label, &fps, 1.0f, 60.0f)) {
+        controls.fps = fps;
+        g_collector.ratesChanged();
+    }
 
-    float max_scale = (has_cooling_device && !has_direct_fan) ? 10.0f : 5000.0f;
-    ImGui::SliderFloat("Scale##fan", &g_fan_data.scale, 0.0f, max_scale);
+    // Scale Slider
+    snprintf(label, sizeof(label), "Scale##%s", suffix);
+    ImGui::SliderFloat(label, &controls.scale, 0.0f, max_scale);
 
     // Animation Toggle
-    ImGui::Checkbox("Animate##fan", &g_fan_data.animate);
+    snprintf(label, sizeof(label), "Animate##%s", suffix);
+    bool animate = controls.animate;
+    if (ImGui::Checkbox(label, &animate)) {
+        controls.animate = animate;
+    }
 
-    ImGui::Spacing();
+    // Time span, read from the matching history tier
+    ImGui::SameLine();
+    snprintf(label, sizeof(label), "Span##%s", suffix);
+    ImGui::SetNextItemWidth(100.0f);
+    renderSpanSelector(label, controls.span);
+}
 
-    // Check what type of cooling/fan data we have
-    static bool has_hwmon_fan = false;
-
-    // Check for hwmon fan files
-    if (!has_hwmon_fan) {
-        DIR* hwmon = opendir("/sys/class/hwmon");
-        if (hwmon) {
-            struct dirent* entry;
-            while ((entry = readdir(hwmon)) != nullptr) {
-                if (entry->d_name[0] == '.') continue;
-                std::string device_path = "/sys/class/hwmon/" + std::string(entry->d_name) + "/fan1_input";
-                if (access(device_path.c_str(), F_OK) == 0) {
-                    has_hwmon_fan = true;
-                    break;
-                }
+// What the heatmap colours by; the aggregate busy share is -1
+static int g_heatmap_state = -1;
+
+// One cell per core, green at 0% through red at 100%, wrapped into rows
+// that fit the tab. Cells shrink with the core count, and only the hovered
+// core gets text, so a 256+ core machine costs one rectangle per core.
+static void renderCoreHeatmap(const CPUData& cpu) {
+    static const int STATES[] = {-1, CPU_USER, CPU_SYSTEM, CPU_IOWAIT, CPU_STEAL,
+                                 CPU_IRQ, CPU_SOFTIRQ, CPU_NICE, CPU_GUEST};
+    auto stateName = [](int state) { return state < 0 ? "busy" : describeCPUState((CPUState)state); };
+
+    size_t cores = cpu.core_ids.size();
+    ImGui::Text("Cores (%zu)", cores);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::BeginCombo("Heatmap", stateName(g_heatmap_state))) {
+        for (int state : STATES) {
+            if (ImGui::Selectable(stateName(state), state == g_heatmap_state)) g_heatmap_state = state;
+        }
+        ImGui::EndCombo();
+    }
+    if (cores == 0) return;
+
+    const float* values = g_heatmap_state < 0 ? cpu.core_usage.data()
+                                              : cpu.core_states[g_heatmap_state].data();
+    float cell = cores <= 64 ? 22.0f : cores <= 256 ? 14.0f : 9.0f;
+    float width = std::max(ImGui::GetContentRegionAvail().x, cell);
+    size_t columns = std::max<size_t>(1, (size_t)(width / cell));
+    size_t rows = (cores + columns - 1) / columns;
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("##heatmap", ImVec2(columns * cell, rows * cell));
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    for (size_t core = 0; core < cores; core++) {
+        float value = std::min(std::max(values[core], 0.0f), 100.0f);
+        ImVec2 min(origin.x + (core % columns) * cell, origin.y + (core / columns) * cell);
+        ImVec2 max(min.x + cell - 1.0f, min.y + cell - 1.0f);
+        draw->AddRectFilled(min, max, ImColor::HSV(0.33f * (1.0f - value / 100.0f), 0.85f, 0.35f + 0.55f * value / 100.0f));
+    }
+
+    if (ImGui::IsItemHovered()) {
+        ImVec2 mouse = ImGui::GetIO().MousePos;
+        size_t column = (size_t)((mouse.x - origin.x) / cell);
+        size_t core = (size_t)((mouse.y - origin.y) / cell) * columns + column;
+        if (column < columns && core < cores) {
+            ImGui::BeginTooltip();
+            ImGui::Text("cpu%d: %.1f%% busy", cpu.core_ids[core], cpu.core_usage[core]);
+            for (int state = 0; state < CPU_STATE_COUNT; state++) {
+                if (state == CPU_IDLE) continue;
+                ImGui::Text("  %-10s %5.1f%%", describeCPUState((CPUState)state), cpu.core_states[state][core]);
             }
-            closedir(hwmon);
+            ImGui::EndTooltip();
         }
     }
+}
+
+void renderCPUTab(const CPUData& cpu) {
+    renderGraphControls(g_cpu_controls, "cpu", 100.0f);
+    
+    // CPU Usage Graph
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "CPU: %f%%", cpu.current_usage);
+    static const MetricHistory* history = g_history.metric("cpu.usage");
+    plotHistory("CPU Usage", history, g_cpu_controls.span, overlay,
+        g_cpu_controls.scale, ImVec2(0, 80));
+
+    ImGui::Text("user %.1f%%  nice %.1f%%  system %.1f%%  irq %.1f%%  softirq %.1f%%",
+                cpu.states[CPU_USER], cpu.states[CPU_NICE], cpu.states[CPU_SYSTEM],
+                cpu.states[CPU_IRQ], cpu.states[CPU_SOFTIRQ]);
+    ImVec4 warn(1.0f, 0.5f, 0.0f, 1.0f), plain = ImGui::GetStyleColorVec4(ImGuiCol_Text);
+    ImGui::TextColored(cpu.states[CPU_IOWAIT] >= 5.0f ? warn : plain, "iowait %.1f%%", cpu.states[CPU_IOWAIT]);
+    ImGui::SameLine();
+    ImGui::TextColored(cpu.states[CPU_STEAL] >= 5.0f ? warn : plain, " steal %.1f%%", cpu.states[CPU_STEAL]);
+    ImGui::SameLine();
+    ImGui::Text(" guest %.1f%%", cpu.states[CPU_GUEST] + cpu.states[CPU_GUEST_NICE]);
+
+    renderCoreHeatmap(cpu);
+}
+
+void renderFanTab(const FanData& fan) {
+    // Scale Slider - adjust range based on monitoring type
+    bool cooling_only = (fan.source == FAN_SOURCE_COOLING);
+    renderGraphControls(g_fan_controls, "fan", cooling_only ? 10.0f : 5000.0f);
+
+    ImGui::Spacing();
 
     // Display appropriate status message
-    if (has_direct_fan) {
+    if (fan.source == FAN_SOURCE_DIRECT) {
         ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "✓ Direct fan monitoring available");
-    } else if (has_hwmon_fan) {
+    } else if (fan.source == FAN_SOURCE_HWMON) {
         ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "✓ Hardware monitoring fan detected");
-    } else if (has_cooling_device) {
+    } else if (cooling_only) {
         ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "⚠ Using thermal cooling device");
         ImGui::TextWrapped("No direct fan monitoring available. Showing CPU thermal throttling state instead.");
     } else {
@@ -459,69 +601,80 @@ void renderFanTab() {
     ImGui::Spacing();
 
     // Status information
-    if (has_cooling_device && !has_direct_fan && !has_hwmon_fan) {
-        ImGui::Text("Cooling Status: %s", g_fan_data.enabled ? "Active" : "Inactive");
-        ImGui::Text("Throttle Level: %d%%", g_fan_data.level);
-        ImGui::Text("Cooling State: %d", g_fan_data.speed);
+    if (cooling_only) {
+        ImGui::Text("Cooling Status: %s", fan.enabled ? "Active" : "Inactive");
+        ImGui::Text("Throttle Level: %d%%", fan.level);
+        ImGui::Text("Cooling State: %d", fan.speed);
     } else {
-        ImGui::Text("Fan Status: %s", g_fan_data.enabled ? "Active" : "Inactive");
-        ImGui::Text("Speed: %d RPM", g_fan_data.speed);
-        ImGui::Text("Level: %d%%", g_fan_data.level);
+        ImGui::Text("Fan Status: %s", fan.enabled ? "Active" : "Inactive");
+        ImGui::Text("Speed: %d RPM", fan.speed);
+        ImGui::Text("Level: %d%%", fan.level);
     }
 
     // Fan/Cooling Graph
-    const char* graph_title = (has_cooling_device && !has_direct_fan && !has_hwmon_fan) ?
-                             "Thermal Cooling" : "Fan Speed";
-    const char* overlay_text = (has_cooling_device && !has_direct_fan && !has_hwmon_fan) ?
-                              ("Cooling: " + std::to_string(g_fan_data.speed)).c_str() :
-                              ("Speed: " + std::to_string(g_fan_data.speed) + " RPM").c_str();
-
-    ImGui::PlotLines(graph_title,
-        g_fan_data.history.data(),
-        g_fan_data.history.size(),
-        0,
-        overlay_text,
-        0.0f,
-        g_fan_data.scale,
-        ImVec2(0, 80));
+    const char* graph_title = cooling_only ? "Thermal Cooling" : "Fan Speed";
+    char overlay[32];
+    if (cooling_only) {
+        snprintf(overlay, sizeof(overlay), "Cooling: %d", fan.speed);
+    } else {
+        snprintf(overlay, sizeof(overlay), "Speed: %d RPM", fan.speed);
+    }
+
+    static const MetricHistory* history = g_history.metric("fan.speed");
+    plotHistory(graph_title, history, g_fan_controls.span, overlay,
+        g_fan_controls.scale, ImVec2(0, 80));
 }
 
-void renderThermalTab() {
-    // FPS Slider
-    ImGui::SliderFloat("FPS##thermal", &g_thermal_data.fps, 1.0f, 60.0f);
-    
-    // Scale Slider
-    ImGui::SliderFloat("Scale##thermal", &g_thermal_data.scale, 0.0f, 100.0f);
-    
-    // Animation Toggle
-    ImGui::Checkbox("Animate##thermal", &g_thermal_data.animate);
+void renderThermalTab(const ThermalData& thermal) {
+    renderGraphControls(g_thermal_controls, "thermal", 100.0f);
     
     // Temperature Graph
-    ImGui::PlotLines("Temperature", 
-        g_thermal_data.history.data(), 
-        g_thermal_data.history.size(),
-        0, 
-        ("Temp: " + std::to_string(g_thermal_data.current_temp) + "°C").c_str(),
-        0.0f, 
-        g_thermal_data.scale,
-        ImVec2(0, 80));
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "Temp: %f°C", thermal.current_temp);
+    static const MetricHistory* history = g_history.metric("thermal.temp");
+    plotHistory("Temperature", history, g_thermal_controls.span, overlay,
+        g_thermal_controls.scale, ImVec2(0, 80));
+}
+
+// How each collector is keeping up with its rate
+void renderSamplingTab(const SchedulerSnapshot& scheduler) {
+    if (ImGui::BeginTable("Sampling", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Collector");
+        ImGui::TableSetupColumn("Rate (Hz)");
+        ImGui::TableSetupColumn("Runs");
+        ImGui::TableSetupColumn("Missed");
+        ImGui::TableSetupColumn("Worst late (ms)");
+        ImGui::TableSetupColumn("Last run (ms)");
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < TASK_COUNT; i++) {
+            const TaskStats& task = scheduler.tasks[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(describeSampleTask((SampleTask)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", task.rate);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)task.runs);
+            ImGui::TableNextColumn();
+            if (task.missed > 0) {
+                ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%llu", (unsigned long long)task.missed);
+            } else {
+                ImGui::TextUnformatted("0");
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", task.worst_lateness * 1000.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", task.last_duration * 1000.0f);
+        }
+        ImGui::EndTable();
+    }
 }
 
 // Main system window render function
 void systemWindow(const char* id, ImVec2 size, ImVec2 position) {
-    // Update data
-    static auto last_update = std::chrono::steady_clock::now();
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_update);
-    
-    if (duration.count() >= 1000) { // Update every second
-        updateSystemInfo();
-        updateProcessStats();
-        updateCPUData();
-        updateFanData();
-        updateThermalData();
-        last_update = now;
-    }
+    const MonitorSnapshot& current = g_collector.current();
+    const SystemSnapshot& snapshot = current.system;
 
     // Begin window
     ImGui::Begin(id);
@@ -529,22 +682,26 @@ void systemWindow(const char* id, ImVec2 size, ImVec2 position) {
     ImGui::SetWindowPos(id, position);
 
     // Render system information
-    renderSystemInfo();
+    renderSystemInfo(snapshot.info, current.processes.stats);
     
     ImGui::Separator();
 
     // Render tabs
     if (ImGui::BeginTabBar("SystemTabs")) {
         if (ImGui::BeginTabItem("CPU")) {
-            renderCPUTab();
+            renderCPUTab(snapshot.cpu);
             ImGui::EndTabItem();
         }
         if (ImGui::BeginTabItem("Fan")) {
-            renderFanTab();
+            renderFanTab(snapshot.fan);
             ImGui::EndTabItem();
         }
         if (ImGui::BeginTabItem("Thermal")) {
-            renderThermalTab();
+            renderThermalTab(snapshot.thermal);
+            ImGui::EndTabItem();
+        }
+        if (ImGui::BeginTabItem("Sampling")) {
+            renderSamplingTab(current.scheduler);
             ImGui::EndTabItem();
         }
         ImGui::EndTabBar();
@@ -0,0 +1,310 @@
+#include "header.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+
+// Requests in flight before replies are drained; bounds the receive queue
+static const size_t TASKSTATS_BATCH = 64;
+
+// Netlink attributes are appended in place; the caller sizes the buffer
+static void appendAttribute(struct nlmsghdr* header, uint16_t type, const void* data, size_t length) {
+    struct nlattr* attribute = (struct nlattr*)((char*)header + NLMSG_ALIGN(header->nlmsg_len));
+    attribute->nla_type = type;
+    attribute->nla_len = NLA_HDRLEN + length;
+    memcpy((char*)attribute + NLA_HDRLEN, data, length);
+    header->nlmsg_len = NLMSG_ALIGN(header->nlmsg_len) + NLA_ALIGN(attribute->nla_len);
+}
+
+static struct nlmsghdr* beginRequest(char* request, uint16_t type, uint8_t command, uint32_t sequence) {
+    struct nlmsghdr* header = (struct nlmsghdr*)request;
+    header->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    header->nlmsg_type = type;
+    header->nlmsg_flags = NLM_F_REQUEST;
+    header->nlmsg_seq = sequence;
+    header->nlmsg_pid = 0;
+
+    struct genlmsghdr* generic = (struct genlmsghdr*)NLMSG_DATA(header);
+    generic->cmd = command;
+    generic->version = 1;
+    generic->reserved = 0;
+    return header;
+}
+
+static bool sendRequest(int sock, struct nlmsghdr* header) {
+    struct sockaddr_nl kernel = {};
+    kernel.nl_family = AF_NETLINK;
+    while (sendto(sock, header, header->nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel)) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+static int openGenericSocket() {
+    int sock = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (sock < 0) return -1;
+
+    // Replies come straight back, so a missing one means the kernel dropped it
+    struct timeval timeout = {0, 200 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Looks up the dynamically assigned id of the TASKSTATS family
+static uint16_t resolveFamily(int sock, std::vector<char>& buffer) {
+    char request[256] __attribute__((aligned(NLMSG_ALIGNTO))) = {};
+    struct nlmsghdr* header = beginRequest(request, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1);
+    appendAttribute(header, CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME));
+    if (!sendRequest(sock, header)) return 0;
+
+    ssize_t length = recv(sock, buffer.data(), buffer.size(), 0);
+    if (length < 0) return 0;
+
+    struct nlmsghdr* reply = (struct nlmsghdr*)buffer.data();
+    if (!NLMSG_OK(reply, (int)length) || reply->nlmsg_type == NLMSG_ERROR) return 0;
+
+    int remaining = reply->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    struct nlattr* attribute = (struct nlattr*)((char*)NLMSG_DATA(reply) + GENL_HDRLEN);
+    while (remaining >= (int)NLA_HDRLEN && attribute->nla_len >= NLA_HDRLEN &&
+           attribute->nla_len <= remaining) {
+        if (attribute->nla_type == CTRL_ATTR_FAMILY_ID) {
+            return *(uint16_t*)((char*)attribute + NLA_HDRLEN);
+        }
+        remaining -= NLA_ALIGN(attribute->nla_len);
+        attribute = (struct nlattr*)((char*)attribute + NLA_ALIGN(attribute->nla_len));
+    }
+    return 0;
+}
+
+// Reads the id and struct taskstats nested in an AGGR_TGID/AGGR_PID
+// attribute. Older kernels send a shorter struct, so missing tail fields
+// stay zero.
+static bool parseAggregate(struct nlattr* attribute, uint32_t& id, struct taskstats& stats) {
+    int remaining = attribute->nla_len - NLA_HDRLEN;
+    struct nlattr* nested = (struct nlattr*)((char*)attribute + NLA_HDRLEN);
+    bool have_stats = false;
+
+    while (remaining >= (int)NLA_HDRLEN && nested->nla_len >= NLA_HDRLEN &&
+           nested->nla_len <= remaining) {
+        char* payload = (char*)nested + NLA_HDRLEN;
+        size_t payload_length = nested->nla_len - NLA_HDRLEN;
+        if (nested->nla_type == TASKSTATS_TYPE_PID || nested->nla_type == TASKSTATS_TYPE_TGID) {
+            memcpy(&id, payload, sizeof(id));
+        } else if (nested->nla_type == TASKSTATS_TYPE_STATS) {
+            memset(&stats, 0, sizeof(stats));
+            memcpy(&stats, payload, std::min(payload_length, sizeof(stats)));
+            have_stats = true;
+        }
+        remaining -= NLA_ALIGN(nested->nla_len);
+        nested = (struct nlattr*)((char*)nested + NLA_ALIGN(nested->nla_len));
+    }
+    return have_stats;
+}
+
+// Finds the first AGGR_TGID/AGGR_PID attribute of a query reply
+static bool extractTaskstats(struct nlmsghdr* reply, uint32_t& id, struct taskstats& stats) {
+    int remaining = reply->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    struct nlattr* attribute = (struct nlattr*)((char*)NLMSG_DATA(reply) + GENL_HDRLEN);
+
+    while (remaining >= (int)NLA_HDRLEN && attribute->nla_len >= NLA_HDRLEN &&
+           attribute->nla_len <= remaining) {
+        if (attribute->nla_type == TASKSTATS_TYPE_AGGR_TGID ||
+            attribute->nla_type == TASKSTATS_TYPE_AGGR_PID) {
+            return parseAggregate(attribute, id, stats);
+        }
+        remaining -= NLA_ALIGN(attribute->nla_len);
+        attribute = (struct nlattr*)((char*)attribute + NLA_ALIGN(attribute->nla_len));
+    }
+    return false;
+}
+
+static void copyCounters(const struct taskstats& stats, TaskCounters& out) {
+    out.cpu_delay = stats.cpu_delay_total;
+    out.blkio_delay = stats.blkio_delay_total;
+    out.swapin_delay = stats.swapin_delay_total;
+    out.read_bytes = stats.read_bytes;
+    out.write_bytes = stats.write_bytes;
+}
+
+// The CPUs that can ever be online, in the list format the exit listener
+// registration takes, e.g. "0-3,8-11"
+static bool possibleCPUs(char* list, size_t size) {
+    char resolved[PATH_MAX];
+    FILE* file = fopen(resolveKernelPath("/sys/devices/system/cpu/possible", resolved), "r");
+    if (!file) return false;
+    bool read = fgets(list, size, file) != nullptr;
+    fclose(file);
+    if (!read) return false;
+    list[strcspn(list, "\n")] = '\0';
+    return list[0] != '\0';
+}
+
+TaskstatsClient::~TaskstatsClient() {
+    close();
+}
+
+bool TaskstatsClient::open() {
+    if (sock >= 0) return true;
+
+    // Large enough for the biggest struct taskstats plus headers, many times over
+    buffer.resize(16384);
+
+    sock = openGenericSocket();
+    if (sock < 0) return false;
+
+    family = resolveFamily(sock, buffer);
+    if (family == 0) {
+        close();
+        return false;
+    }
+
+    // Registering for exit records is optional: queries work without it
+    char cpumask[128];
+    exit_sock = possibleCPUs(cpumask, sizeof(cpumask)) ? openGenericSocket() : -1;
+    if (exit_sock >= 0) {
+        char request[256] __attribute__((aligned(NLMSG_ALIGNTO))) = {};
+        struct nlmsghdr* header = beginRequest(request, family, TASKSTATS_CMD_GET, ++sequence);
+        appendAttribute(header, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK, cpumask, strlen(cpumask) + 1);
+        if (!sendRequest(exit_sock, header)) {
+            ::close(exit_sock);
+            exit_sock = -1;
+        }
+    }
+    return true;
+}
+
+void TaskstatsClient::close() {
+    if (sock >= 0) ::close(sock);
+    if (exit_sock >= 0) ::close(exit_sock);
+    sock = -1;
+    exit_sock = -1;
+    family = 0;
+}
+
+void TaskstatsClient::query(const std::vector<pid_t>& tgids,
+                            std::vector<TaskCounters>& counters,
+                            std::vector<bool>& found) {
+    counters.assign(tgids.size(), TaskCounters{});
+    found.assign(tgids.size(), false);
+    if (sock < 0) return;
+
+    char request[64] __attribute__((aligned(NLMSG_ALIGNTO)));
+    for (size_t first = 0; first < tgids.size(); first += TASKSTATS_BATCH) {
+        size_t last = std::min(tgids.size(), first + TASKSTATS_BATCH);
+
+        // Send the whole batch, then match replies back by sequence number
+        uint32_t base = sequence + 1;
+        size_t outstanding = 0;
+        for (size_t i = first; i < last; i++) {
+            memset(request, 0, sizeof(request));
+            struct nlmsghdr* header = beginRequest(request, family, TASKSTATS_CMD_GET, base + (i - first));
+            uint32_t tgid = tgids[i];
+            appendAttribute(header, TASKSTATS_CMD_ATTR_TGID, &tgid, sizeof(tgid));
+            if (sendRequest(sock, header)) outstanding++;
+        }
+        sequence = base + (last - first);
+
+        while (outstanding > 0) {
+            ssize_t length = recv(sock, buffer.data(), buffer.size(), 0);
+            if (length < 0) {
+                if (errno == EINTR) continue;
+                // Timed out or the queue overflowed; unanswered pids stay not found
+                break;
+            }
+
+            int remaining = (int)length;
+            for (struct nlmsghdr* reply = (struct nlmsghdr*)buffer.data();
+                 NLMSG_OK(reply, remaining);
+                 reply = NLMSG_NEXT(reply, remaining)) {
+                if (reply->nlmsg_seq < base || reply->nlmsg_seq >= sequence) continue;
+                outstanding--;
+
+                // Exited pids come back as NLMSG_ERROR with -ESRCH
+                if (reply->nlmsg_type != family) continue;
+
+                uint32_t id = 0;
+                struct taskstats stats;
+                if (!extractTaskstats(reply, id, stats)) continue;
+
+                size_t index = first + (reply->nlmsg_seq - base);
+                copyCounters(stats, counters[index]);
+                found[index] = true;
+            }
+        }
+    }
+}
+
+// What collectExits() took a tgid's counters from, weakest first
+enum : uint8_t { EXIT_NONE, EXIT_THREAD, EXIT_GROUP };
+
+// A task's exit record carries AGGR_PID with its own counters and, when it
+// was the last thread of a multithreaded group, AGGR_TGID with the group's.
+// A single-threaded process only gets AGGR_PID, with pid == tgid.
+void TaskstatsClient::collectExits(const std::vector<pid_t>& tgids,
+                                   std::vector<TaskCounters>& counters,
+                                   std::vector<bool>& found) {
+    if (exit_sock < 0) return;
+    exit_record.assign(tgids.size(), EXIT_NONE);
+
+    for (;;) {
+        ssize_t length = recv(exit_sock, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (length < 0) {
+            // ENOBUFS: records were lost while the socket was full; keep reading
+            if (errno == EINTR || errno == ENOBUFS) continue;
+            break;
+        }
+
+        int remaining_messages = (int)length;
+        for (struct nlmsghdr* record = (struct nlmsghdr*)buffer.data();
+             NLMSG_OK(record, remaining_messages);
+             record = NLMSG_NEXT(record, remaining_messages)) {
+            if (record->nlmsg_type != family) continue;
+
+            int remaining = record->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+            struct nlattr* attribute = (struct nlattr*)((char*)NLMSG_DATA(record) + GENL_HDRLEN);
+            while (remaining >= (int)NLA_HDRLEN && attribute->nla_len >= NLA_HDRLEN &&
+                   attribute->nla_len <= remaining) {
+                uint8_t kind = attribute->nla_type == TASKSTATS_TYPE_AGGR_TGID ? EXIT_GROUP :
+                               attribute->nla_type == TASKSTATS_TYPE_AGGR_PID ? EXIT_THREAD : EXIT_NONE;
+                uint32_t id = 0;
+                struct taskstats stats;
+                if (kind != EXIT_NONE && parseAggregate(attribute, id, stats)) {
+                    auto it = std::lower_bound(tgids.begin(), tgids.end(), (pid_t)id);
+                    size_t index = it - tgids.begin();
+                    // Counters of a live group win over any exit record, and a
+                    // group total over the record of its leader thread alone
+                    if (it != tgids.end() && *it == (pid_t)id && !found[index] &&
+                        kind >= exit_record[index]) {
+                        copyCounters(stats, counters[index]);
+                        exit_record[index] = kind;
+                    }
+                }
+                remaining -= NLA_ALIGN(attribute->nla_len);
+                attribute = (struct nlattr*)((char*)attribute + NLA_ALIGN(attribute->nla_len));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < tgids.size(); i++) {
+        if (exit_record[i] != EXIT_NONE) found[i] = true;
+    }
+}
+
+bool delayAccountingEnabled() {
+    char value[8] = {};
+    char resolved[PATH_MAX];
+    FILE* file = fopen(resolveKernelPath("/proc/sys/kernel/task_delayacct", resolved), "r");
+    if (!file) return false;
+    bool enabled = fgets(value, sizeof(value), file) && value[0] == '1';
+    fclose(file);
+    return enabled;
+}